@@ -2,6 +2,8 @@
 * Timing Instrumentation Macros, provides
 *   DECLARE_TIMER, START_TIMER, STOP_TIMER,PRINT_TIMER    (Original Timers.h)
 *   BEGIN_REPEAT_TIMING, END_REPEAT_TIMING, PRINT_RTIMER 
+*   DECLARE_WTIMER, DECLARE_TTIMER, DECLARE_CTIMER      (nanosecond timers)
+*   START_NTIMER, STOP_NTIMER, RESET_NTIMER, PRINT_NTIMER, ELAPSED_NTIMER
 *
 * Usage:
 *  To "enable" compile with -DTIMING
@@ -23,6 +25,11 @@
 #ifndef _TIMERS_H_
 #define _TIMERS_H_
 
+/* clock_gettime() is POSIX, make sure it is declared under -std=c99 */
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 /******************************************************************************
 * The #warning pre-processor directive provided by the GNU gcc compiler will
 * print a warning when the timers are enabled 
@@ -143,6 +150,112 @@
                      R, ((double)A.Elapsed / (double)CLOCKS_PER_SEC)/(double)R);  \
     } /*PRINT_RTIMER() */
 
+  /****************************************************************************
+  * Nanosecond timers.  The clock() timers above measure the CPU time of the
+  * whole process, which grows with the number of threads, these measure
+  *   DECLARE_WTIMER(A) - wall clock time, CLOCK_MONOTONIC
+  *   DECLARE_TTIMER(A) - CPU time of the calling thread only,
+  *                       CLOCK_THREAD_CPUTIME_ID
+  *   DECLARE_CTIMER(A) - TSC cycles on x86 (wall clock ns elsewhere), only
+  *                       comparable across cores if TIMER_TSC_INVARIANT()
+  * and share START_NTIMER, STOP_NTIMER, RESET_NTIMER and PRINT_NTIMER.
+  * ELAPSED_NTIMER(A) is the accumulated time in seconds (cycles for a TSC
+  * timer), 0 when the timers are compiled out.  A timer lives in the
+  * caller's scope so each worker thread can declare its own.
+  ****************************************************************************/
+  #define TIMER_TSC                 (-1)   /* Clock id of the cycle timers */
+
+  struct nsTimerDetails {
+      long long Start;     /* Start Time   - set when the timer is started */
+      long long Elapsed;   /* Elapsed Time - Accumulated when timer is stopped */
+      int State;           /* Timer State  - 0=stopped / 1=running */
+      int Clock;           /* clockid_t of the timer or TIMER_TSC */
+  };
+
+  #if defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+  /* Invariant TSC ticks at a constant rate in all power states */
+  static inline int _timer_tsc_invariant(void) {
+     unsigned a, b, c, d;
+     if (!__get_cpuid(0x80000007, &a, &b, &c, &d)) {
+        return(0);
+     }
+     return((d >> 8) & 1);
+  }
+  #define _TIMER_CYCLES()   ((long long)__builtin_ia32_rdtsc())
+  #else
+  static inline int _timer_tsc_invariant(void) {
+     return(0);
+  }
+  #define _TIMER_CYCLES()   _timer_now(CLOCK_MONOTONIC)
+  #endif
+
+  static inline long long _timer_now(int clock) {
+     struct timespec ts;
+     if (clock == TIMER_TSC) {
+        return(_TIMER_CYCLES());
+     }
+     clock_gettime((clockid_t)clock, &ts);
+     return((long long)ts.tv_sec*1000000000LL + ts.tv_nsec);
+  }
+
+  #define TIMER_TSC_INVARIANT()     _timer_tsc_invariant()
+
+  #define DECLARE_WTIMER(A)                                                   \
+    struct nsTimerDetails A = {0, 0, 0, CLOCK_MONOTONIC};
+
+  #define DECLARE_TTIMER(A)                                                   \
+    struct nsTimerDetails A = {0, 0, 0, CLOCK_THREAD_CPUTIME_ID};
+
+  #define DECLARE_CTIMER(A)                                                   \
+    struct nsTimerDetails A = {0, 0, 0, TIMER_TSC};
+
+  #define START_NTIMER(A)                                                     \
+    {                                                                         \
+     if (1 == A.State) {                                                      \
+       fprintf(stderr, "Error, running timer "#A" started.\n");               \
+     }                                                                        \
+     A.State = 1;                                                             \
+     A.Start = _timer_now(A.Clock);                                           \
+    } /* START_NTIMER() */
+
+  #define RESET_NTIMER(A)                                                     \
+    {                                                                         \
+     A.Elapsed = 0;                                                           \
+    } /* RESET_NTIMER() */
+
+  #define STOP_NTIMER(A)                                                      \
+    {                                                                         \
+     long long _stop = _timer_now(A.Clock);                                   \
+     if (0 == A.State) {                                                      \
+       fprintf(stderr, "Error, stopped timer "#A" stopped again.\n");         \
+     }                                                                        \
+     else {                                                                   \
+       A.Elapsed += _stop - A.Start;                                          \
+     }                                                                        \
+     A.State = 0;                                                             \
+    } /* STOP_NTIMER() */
+
+  /* Seconds, or cycles for a TSC timer, including a running interval */
+  #define ELAPSED_NTIMER(A)                                                   \
+    ((A.Clock == TIMER_TSC ? 1.0 : 1e-9) *                                    \
+     (double)(A.Elapsed + (A.State ? _timer_now(A.Clock) - A.Start : 0)))
+
+  #define PRINT_NTIMER(A)                                                     \
+    {                                                                         \
+     if (1 == A.State) {                                                      \
+       STOP_NTIMER(A);                                                        \
+     }                                                                        \
+     if (A.Clock == TIMER_TSC) {                                              \
+       fprintf(stderr, "Elapsed Cycles ("#A") = %lld\n", A.Elapsed);          \
+     }                                                                        \
+     else {                                                                   \
+       fprintf(stderr, "Elapsed %s Time ("#A") = %.9f sec.\n",                \
+               (A.Clock == CLOCK_MONOTONIC) ? "Wall" : "Thread CPU",          \
+               (double)A.Elapsed*1e-9);                                       \
+     }                                                                        \
+    } /* PRINT_NTIMER() */
+
 #else /* not defined(TIMING) */
 
   /* Declare null macros for error-free compilation */
@@ -155,6 +268,15 @@
   #define DECLARE_REPEAT_VAR(R)     /* Null Macro */
   #define BEGIN_REPEAT_TIMING(R,V)  /* Null Macro */
   #define END_REPEAT_TIMING         /* Null Macro */
+  #define DECLARE_WTIMER(A)         /* Null Macro */
+  #define DECLARE_TTIMER(A)         /* Null Macro */
+  #define DECLARE_CTIMER(A)         /* Null Macro */
+  #define START_NTIMER(A)           /* Null Macro */
+  #define STOP_NTIMER(A)            /* Null Macro */
+  #define RESET_NTIMER(A)           /* Null Macro */
+  #define PRINT_NTIMER(A)           /* Null Macro */
+  #define ELAPSED_NTIMER(A)         (0.0)
+  #define TIMER_TSC_INVARIANT()     (0)
 
 #endif /* defined(TIMING) */
 
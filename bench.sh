@@ -0,0 +1,113 @@
+#!/bin/sh
+#  Scaling benchmark for hw13
+#
+#  Sweeps thread counts, data sizes and fill kernels.  Every configuration
+#  gets WARMUP unrecorded runs and then REPS timed runs of which the median,
+#  minimum and standard deviation of the fill wall time are kept.  Speedup
+#  and parallel efficiency are relative to the 1 thread median of the same
+#  size and kernel.  Results go to a CSV file.
+#
+#  The whole sweep stops starting new runs once BUDGET seconds are used and
+#  every single run is killed after RUN_LIMIT seconds, so the target always
+#  finishes in bounded time.  Skipped configurations are listed in the CSV
+#  with a status column.
+#
+#  Settings come from the environment (make bench passes them on):
+#    EXE      - the binary, default ./hw13
+#    THREADS  - thread counts, default "1 2 4 8"
+#    SIZES    - element counts, default "1e6 1e7 1e8"
+#    KERNELS  - fill kernels, default "sse2 avx2 avx512", the ones the CPU
+#               lacks are skipped
+#    REPS     - timed runs per configuration, default 5
+#    WARMUP   - untimed runs per configuration, default 1
+#    BUDGET   - seconds for the whole sweep, default 300
+#    RUN_LIMIT- seconds for one run, default 60
+#    OUT      - CSV file, default bench.csv
+#    ARGS     - extra hw13 options, e.g. "-p steal -m thp"
+
+EXE=${EXE:-./hw13}
+THREADS=${THREADS:-"1 2 4 8"}
+SIZES=${SIZES:-"1e6 1e7 1e8"}
+KERNELS=${KERNELS:-"sse2 avx2 avx512"}
+REPS=${REPS:-5}
+WARMUP=${WARMUP:-1}
+BUDGET=${BUDGET:-300}
+RUN_LIMIT=${RUN_LIMIT:-60}
+OUT=${OUT:-bench.csv}
+ARGS=${ARGS:-}
+
+start=$(date +%s)
+times=$(mktemp) || exit 1
+stats=$(mktemp --suffix=.csv) || exit 1
+trap 'rm -f "$times" "$stats"' EXIT
+
+# Run hw13 once and print its fill wall time in ns resolution from the
+# statistics file, nothing if the run failed or did not verify
+run_once() {
+   : > "$stats"
+   timeout "$RUN_LIMIT" "$EXE" -t "$1" -n "$2" -k "$3" -S "$stats" $ARGS 2>/dev/null |
+      grep -q success && awk -F, '$1 == "all" { print $4 }' "$stats"
+}
+
+# Seconds left of the budget
+left() {
+   echo $((BUDGET - ($(date +%s) - start)))
+}
+
+echo "kernel,elements,threads,reps,median_sec,min_sec,stddev_sec,gb_per_sec,speedup,efficiency,status" > "$OUT"
+
+for kernel in $KERNELS; do
+   # The kernel test run also catches a CPU without it
+   if [ -z "$(run_once 1 1000 "$kernel")" ]; then
+      echo "Skipping $kernel, not supported"
+      continue
+   fi
+   for size in $SIZES; do
+      base=""
+      for threads in $THREADS; do
+         if [ "$(left)" -le 0 ]; then
+            echo "$kernel,$size,$threads,0,,,,,,,budget" >> "$OUT"
+            continue
+         fi
+         echo "Running $kernel $size elements $threads threads"
+
+         i=0
+         while [ $i -lt "$WARMUP" ]; do
+            run_once "$threads" "$size" "$kernel" > /dev/null
+            i=$((i + 1))
+         done
+         : > "$times"
+         i=0
+         while [ $i -lt "$REPS" ] && [ "$(left)" -gt 0 ]; do
+            run_once "$threads" "$size" "$kernel" >> "$times"
+            i=$((i + 1))
+         done
+
+         # Median, minimum and sample standard deviation of the runs
+         line=$(sort -g "$times" | awk -v k="$kernel" -v n="$size" -v t="$threads" \
+                -v base="$base" -v bytes="${BYTES:-4}" '
+            { x[NR] = $1; s += $1; ss += $1*$1 }
+            END {
+               if (NR == 0) { printf "%s,%s,%s,0,,,,,,,failed\n", k, n, t; exit }
+               med = (NR % 2) ? x[(NR+1)/2] : (x[NR/2] + x[NR/2+1])/2
+               v = (NR > 1) ? (ss - s*s/NR)/(NR - 1) : 0
+               sd = (v > 0) ? sqrt(v) : 0
+               gbs = (med > 0) ? n*bytes/med/1e9 : 0
+               sp = ""; ef = ""
+               if (base != "" && med > 0) { sp = base/med; ef = sp/t }
+               printf "%s,%s,%d,%d,%.6f,%.6f,%.6f,%.3f,%s,%s,ok\n",
+                      k, n, t, NR, med, x[1], sd, gbs,
+                      (sp == "") ? "" : sprintf("%.3f", sp),
+                      (ef == "") ? "" : sprintf("%.3f", ef)
+            }')
+         echo "$line" >> "$OUT"
+
+         # The 1 thread median is the base of the speedup
+         if [ "$threads" = "1" ]; then
+            base=$(echo "$line" | cut -d, -f5)
+         fi
+      done
+   done
+done
+
+echo "Benchmark results in $OUT ($(($(date +%s) - start)) sec)"
@@ -0,0 +1,84 @@
+#!/bin/sh
+#  Fast regression pass for hw13
+#
+#  Runs every scheduling policy, fill kernel, generator and mode once on a
+#  small array and expects each run to verify.  Two runs with a corrupted
+#  element, one per check method, must fail, they need the -inject option
+#  of the test build.  Kernels the CPU lacks are skipped.  Prints one line
+#  per run and exits 1 if any run went wrong.  Run it with make check, add
+#  WIDE=1 to run it on 64 bit elements.
+#
+#  Settings come from the environment:
+#    EXE      - the binary, default ./hw13_test
+#    SIZE     - elements per run, default 1e6
+#    THREADS  - threads per run, default 4
+#    RUN_LIMIT- seconds for one run, default 60
+
+EXE=${EXE:-./hw13_test}
+SIZE=${SIZE:-1e6}
+THREADS=${THREADS:-4}
+RUN_LIMIT=${RUN_LIMIT:-60}
+
+runs=0
+fails=0
+out=$(mktemp) || exit 1
+file=$(mktemp) || exit 1
+export=$(mktemp) || exit 1
+trap 'rm -f "$out" "$file" "$export"' EXIT
+
+# Run hw13 with the given options, expect an exit code of 0 and success
+pass() {
+   runs=$((runs + 1))
+   if timeout "$RUN_LIMIT" "$EXE" -t "$THREADS" -n "$SIZE" "$@" > "$out" 2>&1 &&
+      grep -q success "$out"; then
+      echo "ok    $*"
+   else
+      echo "FAIL  $*"
+      fails=$((fails + 1))
+   fi
+}
+
+# Run hw13 with the given options, expect the check to report an error
+fail() {
+   runs=$((runs + 1))
+   if ! timeout "$RUN_LIMIT" "$EXE" -t "$THREADS" -n "$SIZE" "$@" > "$out" 2>&1 &&
+      grep -q Error "$out" && ! grep -q success "$out"; then
+      echo "ok    $* (failed as expected)"
+   else
+      echo "FAIL  $* (should have failed)"
+      fails=$((fails + 1))
+   fi
+}
+
+for policy in static dynamic guided steal; do
+   pass -p "$policy"
+done
+
+for kernel in scalar sse2 avx2 avx512; do
+   if "$EXE" -t 1 -n 1000 -k "$kernel" 2>&1 | grep -q "not supported"; then
+      echo "skip  -k $kernel, not supported"
+      continue
+   fi
+   pass -k "$kernel"
+done
+
+for gen in affine:7,-5 poly:1,2,3 philox:9; do
+   pass -g "$gen"
+   pass -g "$gen" -check digest
+done
+
+pass -pipe 2
+pass -pipe 2 -g philox -o "$export"
+pass -window 4096
+pass -m "file:$file" -o "$export"
+pass -m thp -prefault
+pass -stores both
+pass -scan
+pass -submit 16
+
+# A flipped bit must not get through either check
+fail -inject 12345
+fail -inject 12345 -check digest
+
+echo "$runs runs, $fails failed"
+[ "$fails" -eq 0 ]
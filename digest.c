@@ -0,0 +1,382 @@
+//  Segment digests for checksum verification
+//
+//  The CRC is kept in its usual pre and post inverted form between calls,
+//  so crc32c(0, buf, len) is the standard CRC32C of buf.  Combining two
+//  CRCs uses the zlib crc32_combine() method: the CRC of the first run is
+//  advanced over len zero bytes by squaring a GF(2) operator matrix, then
+//  the CRC of the second run is added.
+
+#include <stdint.h>
+#include <string.h>
+#include "digest.h"
+
+#if defined(__x86_64__)
+#define DIGEST_X86
+#include <immintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Reflected Castagnoli polynomial
+#define CRC32C_POLY         (0x82F63B78u)
+
+// Elements per 8 byte word and per 32 and 64 byte vector register
+#define PER_WORD            ((long)(8/sizeof(elem_t)))
+#define PER_V256            ((long)(32/sizeof(elem_t)))
+#define PER_V512            ((long)(64/sizeof(elem_t)))
+
+// Elements from which a run is split in three parts whose CRCs are
+// computed side by side, below it combining them costs more than it saves
+#define SPLIT_MIN           (1L << 14)
+
+static uint32_t crcTable[256];
+static int crcReady;
+
+static uint32_t crcCombine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+
+/****************************************************************************
+  Start an empty digest
+
+  void digestInit(struct Digest_s *d)
+  Where: struct Digest_s *d - the digest
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void digestInit(struct Digest_s *d) {
+   memset(d, 0, sizeof(*d));
+} // End digestInit
+
+
+#ifdef DIGEST_X86
+/****************************************************************************
+  Digest loop with the crc32 instruction, one 8 byte word per step
+****************************************************************************/
+__attribute__((target("sse4.2")))
+static void digestHard(struct Digest_s *d, const elem_t *src, long count) {
+   uint64_t crc = ~d->crc;
+   uelem_t sum = d->sum, sumSq = d->sumSq;
+   long k = 0;
+
+   for (; k + PER_WORD <= count; k += PER_WORD) {
+      uint64_t w;
+      memcpy(&w, &src[k], 8);
+      crc = _mm_crc32_u64(crc, w);
+      for (long j = 0; j < PER_WORD; j++) {
+         uelem_t x = (uelem_t)src[k + j];
+         sum += x;
+         sumSq += x*x;
+      }
+   }
+   for (; k < count; k++) {
+      uelem_t x = (uelem_t)src[k];
+      uint32_t w;
+      memcpy(&w, &src[k], 4);
+      crc = _mm_crc32_u32((uint32_t)crc, w);
+      sum += x;
+      sumSq += x*x;
+   }
+   d->crc = ~(uint32_t)crc;
+   d->sum = sum;
+   d->sumSq = sumSq;
+} // End digestHard
+
+
+/****************************************************************************
+  Digest loop a 32 byte register at a time, the lanes keep running sums
+  and sums of squares and the four words of each register go through the
+  crc32 instruction.  AVX2 has no 64 bit low multiply, a wide square is
+  lo*lo + 2*lo*hi*2^32 modulo 2^64.  The tail goes to digestHard().
+****************************************************************************/
+__attribute__((target("avx2,sse4.2")))
+static void digestAvx2(struct Digest_s *d, const elem_t *src, long count) {
+   __m256i vSum = _mm256_setzero_si256();
+   __m256i vSq = _mm256_setzero_si256();
+   uelem_t lanes[2][PER_V256];
+   uint64_t crc = (uint32_t)~d->crc, w[4];
+   long k;
+
+   for (k = 0; k + PER_V256 <= count; k += PER_V256) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)&src[k]);
+      memcpy(w, &src[k], 32);
+      crc = _mm_crc32_u64(crc, w[0]);
+      crc = _mm_crc32_u64(crc, w[1]);
+      crc = _mm_crc32_u64(crc, w[2]);
+      crc = _mm_crc32_u64(crc, w[3]);
+#ifdef WIDE_ELEM
+      __m256i cross = _mm256_mul_epu32(x, _mm256_srli_epi64(x, 32));
+      vSum = _mm256_add_epi64(vSum, x);
+      vSq = _mm256_add_epi64(vSq, _mm256_add_epi64(_mm256_mul_epu32(x, x),
+                                                   _mm256_slli_epi64(cross, 33)));
+#else
+      vSum = _mm256_add_epi32(vSum, x);
+      vSq = _mm256_add_epi32(vSq, _mm256_mullo_epi32(x, x));
+#endif
+   } // End registers
+   _mm256_storeu_si256((__m256i *)lanes[0], vSum);
+   _mm256_storeu_si256((__m256i *)lanes[1], vSq);
+   for (long j = 0; j < PER_V256; j++) {
+      d->sum += lanes[0][j];
+      d->sumSq += lanes[1][j];
+   }
+   d->crc = ~(uint32_t)crc;
+   digestHard(d, &src[k], count - k);
+} // End digestAvx2
+
+
+/****************************************************************************
+  The same a 64 byte register at a time.  Each crc32 waits for the one
+  before, so a long run is split in three parts of whole registers whose
+  CRCs are computed side by side and combined at the end.  The tail after
+  the parts goes to digestHard().
+****************************************************************************/
+#ifdef WIDE_ELEM
+#define SQ512(x)  _mm512_add_epi64(_mm512_mul_epu32(x, x), \
+                     _mm512_slli_epi64(_mm512_mul_epu32(x, _mm512_srli_epi64(x, 32)), 33))
+#define ADD512    _mm512_add_epi64
+#else
+#define SQ512(x)  _mm512_mullo_epi32(x, x)
+#define ADD512    _mm512_add_epi32
+#endif
+
+// Word j of the three registers into the three CRCs
+#define CRC3(j)   crcA = _mm_crc32_u64(crcA, wa[j]); \
+                  crcB = _mm_crc32_u64(crcB, wb[j]); \
+                  crcC = _mm_crc32_u64(crcC, wc[j]);
+
+__attribute__((target("avx512f,sse4.2")))
+static void digestAvx512(struct Digest_s *d, const elem_t *src, long count) {
+   __m512i vSum = _mm512_setzero_si512();
+   __m512i vSq = _mm512_setzero_si512();
+   uelem_t lanes[2][PER_V512];
+   long part = (count/3/PER_V512)*PER_V512;
+   const elem_t *a = src, *b = src + part, *c = src + 2*part;
+   uint64_t crcA = (uint32_t)~d->crc, crcB = ~0u, crcC = ~0u;
+   uint64_t wa[8], wb[8], wc[8];
+
+   for (long k = 0; k < part; k += PER_V512) {
+      __m512i xa = _mm512_loadu_si512((const void *)&a[k]);
+      __m512i xb = _mm512_loadu_si512((const void *)&b[k]);
+      __m512i xc = _mm512_loadu_si512((const void *)&c[k]);
+      memcpy(wa, &a[k], 64);
+      memcpy(wb, &b[k], 64);
+      memcpy(wc, &c[k], 64);
+      CRC3(0) CRC3(1) CRC3(2) CRC3(3) CRC3(4) CRC3(5) CRC3(6) CRC3(7)
+      vSum = ADD512(vSum, ADD512(xa, ADD512(xb, xc)));
+      vSq = ADD512(vSq, ADD512(SQ512(xa), ADD512(SQ512(xb), SQ512(xc))));
+   } // End registers
+   _mm512_storeu_si512((void *)lanes[0], vSum);
+   _mm512_storeu_si512((void *)lanes[1], vSq);
+   for (long j = 0; j < PER_V512; j++) {
+      d->sum += lanes[0][j];
+      d->sumSq += lanes[1][j];
+   }
+   d->crc = ~(uint32_t)crcA;
+   d->crc = crcCombine(d->crc, ~(uint32_t)crcB, (uint64_t)part*sizeof(elem_t));
+   d->crc = crcCombine(d->crc, ~(uint32_t)crcC, (uint64_t)part*sizeof(elem_t));
+   digestHard(d, &src[3*part], count - 3*part);
+} // End digestAvx512
+#endif
+
+
+/****************************************************************************
+  Add a run of elements to the end of a digest
+
+  void digestAdd(struct Digest_s *d, const elem_t *src, long count)
+  Where: struct Digest_s *d - the digest
+         const elem_t *src  - the elements
+         long count         - number of elements
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void digestAdd(struct Digest_s *d, const elem_t *src, long count) {
+#ifdef DIGEST_X86
+   if (count >= SPLIT_MIN && __builtin_cpu_supports("avx512f") &&
+       __builtin_cpu_supports("sse4.2")) {
+      digestAvx512(d, src, count);
+      d->count += count;
+      return;
+   }
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2")) {
+      digestAvx2(d, src, count);
+      d->count += count;
+      return;
+   }
+   if (__builtin_cpu_supports("sse4.2")) {
+      digestHard(d, src, count);
+      d->count += count;
+      return;
+   }
+#endif
+   for (long k = 0; k < count; k++) {
+      uelem_t x = (uelem_t)src[k];
+      d->sum += x;
+      d->sumSq += x*x;
+   }
+   d->crc = crc32c(d->crc, src, count*sizeof(elem_t));
+   d->count += count;
+} // End digestAdd
+
+
+/****************************************************************************
+  Append the digest of the following run to a digest
+
+  void digestCombine(struct Digest_s *d, const struct Digest_s *next)
+  Where: struct Digest_s *d          - digest of the first run, updated
+         const struct Digest_s *next - digest of the run right after it
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void digestCombine(struct Digest_s *d, const struct Digest_s *next) {
+   d->crc = crcCombine(d->crc, next->crc, (uint64_t)next->count*sizeof(elem_t));
+   d->sum += next->sum;
+   d->sumSq += next->sumSq;
+   d->count += next->count;
+} // End digestCombine
+
+
+/****************************************************************************
+  Closed form sum and sum of squares of an index range of the affine
+  generator, a*i + b for i = first..first+count-1:
+     sum   = a*S1 + b*n
+     sumSq = a^2*S2 + 2ab*S1 + b^2*n
+  with S1 and S2 the sums of i and i^2 over the range.  S(n) = n(n-1)/2 and
+  n(n-1)(2n-1)/6 are exact in 64 bits by dividing a factor by 2 and one by
+  3 before multiplying, the rest wraps like the element type.
+
+  int digestSums(const struct Gen_s *gen, long first, long count,
+                 uelem_t *sum, uelem_t *sumSq)
+  Where: const struct Gen_s *gen - the generator
+         long first              - first index
+         long count              - number of elements
+         uelem_t *sum            - receives the sum
+         uelem_t *sumSq          - receives the sum of squares
+  Returns: int - 0, -1 if the generator has no closed form
+  Errors: none
+****************************************************************************/
+static uint64_t sumI(uint64_t n) {
+   uint64_t a = n, b = n - 1;
+
+   if (n == 0) {
+      return(0);
+   }
+   if (a%2 == 0) { a /= 2; } else { b /= 2; }
+   return(a*b);
+} // End sumI
+
+static uint64_t sumI2(uint64_t n) {
+   uint64_t a = n, b = n - 1, c = 2*n - 1;
+
+   if (n == 0) {
+      return(0);
+   }
+   if (a%2 == 0) { a /= 2; } else { b /= 2; }
+   if (a%3 == 0) { a /= 3; } else if (b%3 == 0) { b /= 3; } else { c /= 3; }
+   return(a*b*c);
+} // End sumI2
+
+int digestSums(const struct Gen_s *gen, long first, long count, uelem_t *sum,
+               uelem_t *sumSq) {
+   uelem_t a, b, n, s1, s2;
+
+   if (gen->type != GEN_AFFINE) {
+      return(-1);
+   }
+   a = (uelem_t)gen->coef[1];
+   b = (uelem_t)gen->coef[0];
+   n = (uelem_t)count;
+   s1 = (uelem_t)(sumI(first + count) - sumI(first));
+   s2 = (uelem_t)(sumI2(first + count) - sumI2(first));
+   *sum = a*s1 + b*n;
+   *sumSq = a*a*s2 + 2*a*b*s1 + b*b*n;
+   return(0);
+} // End digestSums
+
+
+/****************************************************************************
+  CRC32C of a buffer, software table version
+
+  uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+  Where: uint32_t crc    - CRC of the data before buf, 0 to start
+         const void *buf - the data
+         size_t len      - number of bytes
+  Returns: uint32_t - CRC of the data up to the end of buf
+  Errors: none
+****************************************************************************/
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+   const unsigned char *p = buf;
+
+   // Racing threads all write the same values
+   if (!__atomic_load_n(&crcReady, __ATOMIC_ACQUIRE)) {
+      for (uint32_t i = 0; i < 256; i++) {
+         uint32_t c = i;
+         for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+         }
+         crcTable[i] = c;
+      }
+      __atomic_store_n(&crcReady, 1, __ATOMIC_RELEASE);
+   }
+   crc = ~crc;
+   while (len--) {
+      crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+   }
+   return(~crc);
+} // End crc32c
+
+
+/****************************************************************************
+  GF(2) matrix helpers and the CRC combination, after zlib
+****************************************************************************/
+static uint32_t gf2Times(const uint32_t *mat, uint32_t vec) {
+   uint32_t sum = 0;
+
+   for (; vec; vec >>= 1, mat++) {
+      if (vec & 1) {
+         sum ^= *mat;
+      }
+   }
+   return(sum);
+} // End gf2Times
+
+static void gf2Square(uint32_t *square, const uint32_t *mat) {
+   for (int n = 0; n < 32; n++) {
+      square[n] = gf2Times(mat, mat[n]);
+   }
+} // End gf2Square
+
+static uint32_t crcCombine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+   uint32_t even[32], odd[32];
+   uint32_t row = 1;
+
+   if (len2 == 0) {
+      return(crc1);
+   }
+   // Operator for one zero bit, then two and four bits
+   odd[0] = CRC32C_POLY;
+   for (int n = 1; n < 32; n++) {
+      odd[n] = row;
+      row <<= 1;
+   }
+   gf2Square(even, odd);
+   gf2Square(odd, even);
+
+   // Apply len2 zero bytes to crc1, squaring to 8, 16, 32... bits
+   do {
+      gf2Square(even, odd);
+      if (len2 & 1) {
+         crc1 = gf2Times(even, crc1);
+      }
+      len2 >>= 1;
+      if (len2 == 0) {
+         break;
+      }
+      gf2Square(odd, even);
+      if (len2 & 1) {
+         crc1 = gf2Times(odd, crc1);
+      }
+      len2 >>= 1;
+   } while (len2 != 0);
+   return(crc1 ^ crc2);
+} // End crcCombine
@@ -0,0 +1,41 @@
+/******************************************************************************
+* Segment digests for checksum verification
+*
+* A digest of a run of elements holds
+*   sum   - sum of the elements, wrapping in the element type
+*   sumSq - sum of their squares, wrapping in the element type
+*   crc   - CRC32C (Castagnoli) of their bytes in native order, with the
+*           SSE4.2 crc32 instruction when the CPU has it
+* and is made in one streaming read with no data dependent branches, the
+* sums a whole AVX2 or AVX-512 register at a time.
+* Digests of neighbouring runs combine into the digest of the whole run, so
+* the digest of an array does not depend on how it was split up and can be
+* compared across thread counts, runs and machines of the same byte order.
+*
+* For the affine generator sum and sumSq of any index range also follow in
+* closed form from the sums of i and i^2.
+******************************************************************************/
+#ifndef _DIGEST_H_
+#define _DIGEST_H_
+
+#include <stdint.h>
+#include "fill.h"
+#include "gen.h"
+
+/* Digest of count elements */
+struct Digest_s {
+   long count;
+   uelem_t sum;
+   uelem_t sumSq;
+   uint32_t crc;
+};
+
+/* Function prototypes */
+void digestInit(struct Digest_s *d);
+void digestAdd(struct Digest_s *d, const elem_t *src, long count);
+void digestCombine(struct Digest_s *d, const struct Digest_s *next);
+int digestSums(const struct Gen_s *gen, long first, long count, uelem_t *sum,
+               uelem_t *sumSq);
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif /* _DIGEST_H_ */
@@ -0,0 +1,364 @@
+//  Fill engine with an asynchronous submit/future interface
+//
+//  Every pool worker runs engineWorker() for the life of the engine.  The
+//  workers sleep on the engine's condition variable while the queue is
+//  empty, otherwise they all take chunks of the request at the head of the
+//  queue from its own dynamic scheduler.  The first worker to find the
+//  request's chunks used up takes it off the queue, so the others move on
+//  to the next request while the last chunks are still being written.
+//
+//  A request is freed when its owner freed the future, it is off the
+//  queue and no worker holds it any more, all counted in refs under the
+//  engine lock.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pool.h"
+#include "engine.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// One fill request, the future handed to the caller
+struct Future_s {
+   struct Sched_s sched;      // Hands out the chunks of the request
+   struct Engine_s *eng;      // The engine it was submitted to
+   elem_t *dst;               // Element 0 of the request
+   long first;                // Generator index of element 0
+   struct Gen_s gen;          // Copy of the caller's generator
+   long remaining;            // Elements not yet written, atomic
+   int done;                  // Set once remaining reaches 0, under the lock
+   int refs;                  // Owner, queue and workers holding it
+   struct Future_s *next;     // Next request in the queue
+};
+
+// Argument of one engine worker
+struct EngineWorker_s {
+   struct Engine_s *eng;
+   int id;                    // Worker number for the scheduler
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct Engine_s {
+   struct Pool_s *pool;       // The persistent workers
+   int numThreads;
+   struct EngineWorker_s *workers;
+   FillFn_t fill;             // Kernel for the affine generator
+   long chunk;                // Elements per chunk
+   pthread_mutex_t lock;      // Protects the queue and the futures
+   pthread_cond_t work;       // Signalled when a request is queued
+   pthread_cond_t done;       // Signalled when a request is done
+   struct Future_s *head;     // Oldest queued request
+   struct Future_s *tail;     // Newest queued request
+   int stop;                  // engineDestroy() was called
+};
+
+static void *engineWorker(void *data);
+static void futureDrop(struct Future_s *f);
+
+
+/****************************************************************************
+  Create an engine and start its workers
+
+  struct Engine_s *engineCreate(int numThreads, int kernel, long chunk)
+  Where: int numThreads - number of worker threads
+         int kernel     - one of the KERNEL_xxx values, KERNEL_AUTO for the
+                          widest the CPU supports
+         long chunk     - elements per chunk, 0 for DEFAULT_CHUNK
+  Returns: struct Engine_s * - the engine, NULL on failure
+  Errors: none
+****************************************************************************/
+struct Engine_s *engineCreate(int numThreads, int kernel, long chunk) {
+   struct Engine_s *eng;
+
+   if (numThreads < 1 || chunk < 0) {
+      return(NULL);
+   }
+   eng = calloc(1, sizeof(*eng));
+   if (eng == NULL) {
+      return(NULL);
+   }
+   if (posix_memalign((void **)&eng->workers, CACHE_LINE_SIZE,
+                      numThreads*sizeof(struct EngineWorker_s))) {
+      free(eng);
+      return(NULL);
+   }
+   eng->pool = poolCreate(numThreads);
+   if (eng->pool == NULL) {
+      free(eng->workers);
+      free(eng);
+      return(NULL);
+   }
+   eng->numThreads = numThreads;
+   eng->fill = fillFunc(kernel);
+   eng->chunk = (chunk > 0) ? chunk : DEFAULT_CHUNK;
+   pthread_mutex_init(&eng->lock, NULL);
+   pthread_cond_init(&eng->work, NULL);
+   pthread_cond_init(&eng->done, NULL);
+
+   for (int i = 0; i < numThreads; i++) {
+      eng->workers[i].eng = eng;
+      eng->workers[i].id = i;
+      poolStart(eng->pool, i, engineWorker, &eng->workers[i]);
+   }
+   return(eng);
+} // End engineCreate
+
+
+/****************************************************************************
+  Queue a fill request and return without waiting for it
+
+  struct Future_s *engineSubmit(struct Engine_s *eng, elem_t *buffer,
+                                long first, long count,
+                                const struct Gen_s *gen)
+  Where: struct Engine_s *eng   - the engine
+         elem_t *buffer         - receives count elements, must stay valid
+                                  until the request is done
+         long first             - generator index of buffer[0]
+         long count             - number of elements, may be 0
+         const struct Gen_s *gen - the generator, copied
+  Returns: struct Future_s * - the future of the request, NULL on failure
+  Errors: none
+****************************************************************************/
+struct Future_s *engineSubmit(struct Engine_s *eng, elem_t *buffer, long first,
+                              long count, const struct Gen_s *gen) {
+   struct Future_s *f;
+
+   if (count < 0 || (count > 0 && buffer == NULL) || gen == NULL) {
+      return(NULL);
+   }
+   // The scheduler keeps its cursor on a line of its own
+   if (posix_memalign((void **)&f, CACHE_LINE_SIZE, sizeof(*f))) {
+      return(NULL);
+   }
+   memset(f, 0, sizeof(*f));
+   if (schedInit(&f->sched, POLICY_DYNAMIC, count, eng->chunk, eng->numThreads)) {
+      free(f);
+      return(NULL);
+   }
+   f->eng = eng;
+   f->dst = buffer;
+   f->first = first;
+   f->gen = *gen;
+   f->remaining = count;
+
+   pthread_mutex_lock(&eng->lock);
+   if (count == 0) {
+      f->done = 1;
+      f->refs = 1;
+   }
+   else {
+      f->refs = 2;
+      if (eng->tail == NULL) {
+         eng->head = f;
+      }
+      else {
+         eng->tail->next = f;
+      }
+      eng->tail = f;
+      pthread_cond_broadcast(&eng->work);
+   }
+   pthread_mutex_unlock(&eng->lock);
+   return(f);
+} // End engineSubmit
+
+
+/****************************************************************************
+  Wait until a request is done
+
+  int futureWait(struct Future_s *f)
+  Where: struct Future_s *f - the future
+  Returns: int - 0, the buffer holds the request's elements
+  Errors: none
+****************************************************************************/
+int futureWait(struct Future_s *f) {
+   struct Engine_s *eng = f->eng;
+
+   pthread_mutex_lock(&eng->lock);
+   while (!f->done) {
+      pthread_cond_wait(&eng->done, &eng->lock);
+   }
+   pthread_mutex_unlock(&eng->lock);
+   return(0);
+} // End futureWait
+
+
+/****************************************************************************
+  Check without blocking if a request is done
+
+  int futureReady(struct Future_s *f)
+  Where: struct Future_s *f - the future
+  Returns: int - 1 if done, 0 if it is still queued or running
+  Errors: none
+****************************************************************************/
+int futureReady(struct Future_s *f) {
+   int done;
+
+   pthread_mutex_lock(&f->eng->lock);
+   done = f->done;
+   pthread_mutex_unlock(&f->eng->lock);
+   return(done);
+} // End futureReady
+
+
+/****************************************************************************
+  Give up a future.  A request that is not done yet still runs to the end.
+
+  void futureFree(struct Future_s *f)
+  Where: struct Future_s *f - the future, may be NULL
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void futureFree(struct Future_s *f) {
+   struct Engine_s *eng;
+
+   if (f == NULL) {
+      return;
+   }
+   eng = f->eng;
+   pthread_mutex_lock(&eng->lock);
+   futureDrop(f);
+   pthread_mutex_unlock(&eng->lock);
+} // End futureFree
+
+
+/****************************************************************************
+  Finish the queued requests, stop the workers and free the engine.  Any
+  futures not freed yet must not be used afterwards.
+
+  void engineDestroy(struct Engine_s *eng)
+  Where: struct Engine_s *eng - the engine, may be NULL
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void engineDestroy(struct Engine_s *eng) {
+   if (eng == NULL) {
+      return;
+   }
+   pthread_mutex_lock(&eng->lock);
+   eng->stop = 1;
+   pthread_cond_broadcast(&eng->work);
+   pthread_mutex_unlock(&eng->lock);
+   for (int i = 0; i < eng->numThreads; i++) {
+      poolJoin(eng->pool, i, NULL);
+   }
+   poolDestroy(eng->pool);
+   pthread_cond_destroy(&eng->done);
+   pthread_cond_destroy(&eng->work);
+   pthread_mutex_destroy(&eng->lock);
+   free(eng->workers);
+   free(eng);
+} // End engineDestroy
+
+
+/****************************************************************************
+  Fill one range with a generator, the affine generator with the given
+  progression kernel and the others with their own kernels
+
+  void engineRange(const struct Gen_s *gen, FillFn_t fill, elem_t *dst,
+                   long first, long count)
+  Where: const struct Gen_s *gen - the generator
+         FillFn_t fill           - progression kernel from fillFunc()
+         elem_t *dst             - receives count elements
+         long first              - generator index of dst[0]
+         long count              - number of elements
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void engineRange(const struct Gen_s *gen, FillFn_t fill, elem_t *dst, long first,
+                 long count) {
+   if (gen->type == GEN_AFFINE) {
+      fill(dst, count, genValue(gen, first), gen->coef[1]);
+   }
+   else {
+      genFill(gen, dst, first, count);
+   }
+} // End engineRange
+
+
+/****************************************************************************
+  Verify one range against a generator, the counterpart of engineRange()
+
+  long engineCheck(const struct Gen_s *gen, VerifyFn_t verify,
+                   const elem_t *src, long first, long count)
+  Where: const struct Gen_s *gen - the generator
+         VerifyFn_t verify       - verifier from verifyFunc()
+         const elem_t *src       - the elements to check
+         long first              - generator index of src[0]
+         long count              - number of elements
+  Returns: long - offset of the first mismatch, count if all match
+  Errors: none
+****************************************************************************/
+long engineCheck(const struct Gen_s *gen, VerifyFn_t verify, const elem_t *src,
+                 long first, long count) {
+   if (gen->type == GEN_AFFINE) {
+      return(verify(src, count, genValue(gen, first), gen->coef[1]));
+   }
+   return(genVerify(gen, src, first, count));
+} // End engineCheck
+
+
+/****************************************************************************
+  Drop one reference to a request and free it with the last one, called
+  with the engine lock held
+****************************************************************************/
+static void futureDrop(struct Future_s *f) {
+   if (--f->refs == 0) {
+      schedFree(&f->sched);
+      free(f);
+   }
+} // End futureDrop
+
+
+/****************************************************************************
+  The routine every pool worker runs until engineDestroy().  Fills chunks
+  of the oldest queued request, the worker writing the last elements of a
+  request marks it done.
+****************************************************************************/
+static void *engineWorker(void *data) {
+   struct EngineWorker_s *w = data;
+   struct Engine_s *eng = w->eng;
+   struct Future_s *f;
+   long begin, end;
+
+   pthread_mutex_lock(&eng->lock);
+   for (;;) {
+      while (eng->head == NULL && !eng->stop) {
+         pthread_cond_wait(&eng->work, &eng->lock);
+      }
+      // Stop only once the queue is drained
+      if (eng->head == NULL) {
+         break;
+      }
+      f = eng->head;
+      f->refs++;
+      pthread_mutex_unlock(&eng->lock);
+
+      while (schedNext(&f->sched, w->id, &begin, &end)) {
+         engineRange(&f->gen, eng->fill, &f->dst[begin], f->first + begin, end - begin);
+         if (__atomic_sub_fetch(&f->remaining, end - begin, __ATOMIC_ACQ_REL) == 0) {
+            pthread_mutex_lock(&eng->lock);
+            f->done = 1;
+            pthread_cond_broadcast(&eng->done);
+            pthread_mutex_unlock(&eng->lock);
+         }
+      } // End chunks
+
+      // All chunks are handed out, the next request can start.  The queue's
+      // reference can not be the last while this worker still holds one,
+      // so both go in a single drop after the last use of f.
+      pthread_mutex_lock(&eng->lock);
+      if (eng->head == f) {
+         eng->head = f->next;
+         if (eng->head == NULL) {
+            eng->tail = NULL;
+         }
+         f->refs--;
+      }
+      futureDrop(f);
+   } // End for ever
+   pthread_mutex_unlock(&eng->lock);
+   return(NULL);
+} // End engineWorker
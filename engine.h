@@ -0,0 +1,48 @@
+/******************************************************************************
+* Fill engine, the embeddable part of hw13
+*
+* An engine owns a persistent worker pool (pool.h) and a queue of fill
+* requests.  engineSubmit() queues "fill buffer[0..count-1] with the values
+* first..first+count-1 of a generator" and returns at once with a future,
+* the workers split every request into chunks and take the requests in
+* submission order, so many small requests run back to back on the same
+* threads without any pthread_create()/pthread_join().
+*
+*   struct Engine_s *eng = engineCreate(4, KERNEL_AUTO, 0);
+*   struct Future_s *f = engineSubmit(eng, buf, 0, n, &gen);
+*   ...                           // the fill runs in the background
+*   futureWait(f);                // buf is filled now
+*   futureFree(f);
+*   engineDestroy(eng);
+*
+* The buffer must stay valid until the future is done, the generator is
+* copied.  A future may be freed before it is done, the request still runs.
+* engineRange() and engineCheck() are the single threaded fill and verify
+* of one range the engine workers use, for callers with their own threads.
+*
+* Build with "make lib" for libfill.a and libfill.so.
+******************************************************************************/
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include "fill.h"
+#include "gen.h"
+
+struct Engine_s;
+struct Future_s;
+
+/* Function prototypes */
+struct Engine_s *engineCreate(int numThreads, int kernel, long chunk);
+struct Future_s *engineSubmit(struct Engine_s *eng, elem_t *buffer, long first,
+                              long count, const struct Gen_s *gen);
+int futureWait(struct Future_s *f);
+int futureReady(struct Future_s *f);
+void futureFree(struct Future_s *f);
+void engineDestroy(struct Engine_s *eng);
+
+void engineRange(const struct Gen_s *gen, FillFn_t fill, elem_t *dst, long first,
+                 long count);
+long engineCheck(const struct Gen_s *gen, VerifyFn_t verify, const elem_t *src,
+                 long first, long count);
+
+#endif /* _ENGINE_H_ */
@@ -0,0 +1,622 @@
+//  Asynchronous streaming export of the generated data
+//
+//  The io_uring engine talks to the kernel with the raw system calls so no
+//  liburing is needed.  It is only used when <linux/io_uring.h> exists at
+//  build time and io_uring_setup() works at run time (it is often disabled
+//  in containers), otherwise the writer thread falls back to pwritev().
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "export.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Write engines
+#define ENGINE_URING    (0)     // io_uring positioned writes
+#define ENGINE_PWRITEV  (1)     // pwritev() positioned writes
+#define ENGINE_WRITEV   (2)     // writev() in index order for pipes
+
+#ifndef IOV_MAX
+#define IOV_MAX         (1024)
+#endif
+
+// io_uring queue depth and the largest single write handed to it
+#define URING_ENTRIES   (64)
+#define URING_MAX_IO    (8*1024*1024)
+
+// A finished chunk, element indexes begin..end-1
+struct Range_s {
+   long begin;
+   long end;
+};
+
+#ifdef HAVE_IO_URING
+// One write in flight
+struct UringReq_s {
+   struct iovec iov;          // The data, advanced on a short write
+   off_t off;                 // File offset of iov.iov_base
+   int next;                  // Next free request, -1 at the end
+};
+
+// The submission and completion rings shared with the kernel
+struct Uring_s {
+   int fd;
+   void *sqRing, *cqRing;
+   size_t sqRingSize, cqRingSize, sqesSize;
+   unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+   struct io_uring_sqe *sqes;
+   unsigned *cqHead, *cqTail, *cqMask;
+   struct io_uring_cqe *cqes;
+   struct UringReq_s reqs[URING_ENTRIES];
+   int freeReq;               // First free request, -1 if all in flight
+   int inflight;              // Number of requests in flight
+};
+#endif
+
+struct Export_s {
+   int fd;                    // The output
+   int engine;                // One of the ENGINE_xxx values
+   const char *base;          // The data array
+   size_t elemSize;           // Bytes per element
+   long count;                // Number of elements
+   pthread_t writer;          // The writer thread
+   pthread_mutex_t lock;      // Protects the queue, closing and error
+   pthread_cond_t cond;       // Signals new chunks or closing
+   struct Range_s *queue;     // Chunks reported but not taken by the writer
+   long queued, queueCap;
+   struct Range_s *spare;     // The writer's batch, swapped with the queue
+   long spareCap;
+   int closing;               // Set by exportClose()
+   int error;                 // errno of the first failed write, 0 if none
+   struct Range_s *pending;   // In order engine: chunks after a gap
+   long numPending, pendingCap;
+   long next;                 // In order engine: next element to write
+#ifdef HAVE_IO_URING
+   struct Uring_s ring;
+#endif
+};
+
+static void *exportMain(void *data);
+static int compareRange(const void *a, const void *b);
+static void writeRuns(struct Export_s *ex, struct Range_s *r, long n);
+static void writeInOrder(struct Export_s *ex, struct Range_s *r, long n);
+#ifdef HAVE_IO_URING
+static int uringInit(struct Uring_s *ring);
+static void uringSubmit(struct Export_s *ex, off_t off, char *data, size_t len);
+static void uringReap(struct Export_s *ex, int wait);
+static void uringFree(struct Uring_s *ring);
+#endif
+
+static const char *engineNames[] = {"io_uring", "pwritev", "writev"};
+
+
+/****************************************************************************
+  Open the output and start the writer thread
+
+  struct Export_s *exportOpen(const char *path, const void *base,
+                              size_t elemSize, long count)
+  Where: const char *path - file, fifo or device to write to
+         const void *base - the data array
+         size_t elemSize  - bytes per element
+         long count       - number of elements
+  Returns: struct Export_s * - the exporter, NULL on failure with errno set
+  Errors: none
+****************************************************************************/
+struct Export_s *exportOpen(const char *path, const void *base, size_t elemSize,
+                            long count) {
+   struct Export_s *ex = calloc(1, sizeof(*ex));
+   struct stat st;
+   int err;
+
+   if (ex == NULL) {
+      return(NULL);
+   }
+   ex->base = base;
+   ex->elemSize = elemSize;
+   ex->count = count;
+   ex->fd = open(path, O_WRONLY | O_CREAT, 0644);
+   if (ex->fd < 0 || fstat(ex->fd, &st)) {
+      err = errno;
+      if (ex->fd >= 0) {
+         close(ex->fd);
+      }
+      free(ex);
+      errno = err;
+      return(NULL);
+   }
+
+   if (S_ISREG(st.st_mode)) {
+      // Set the final size so the out of order writes land in a sparse file
+      if (ftruncate(ex->fd, (off_t)(count*elemSize))) {
+         err = errno;
+         close(ex->fd);
+         free(ex);
+         errno = err;
+         return(NULL);
+      }
+      ex->engine = ENGINE_PWRITEV;
+#ifdef HAVE_IO_URING
+      if (uringInit(&ex->ring) == 0) {
+         ex->engine = ENGINE_URING;
+      }
+#endif
+   }
+   else {
+      ex->engine = ENGINE_WRITEV;
+   }
+
+   pthread_mutex_init(&ex->lock, NULL);
+   pthread_cond_init(&ex->cond, NULL);
+   if (pthread_create(&ex->writer, NULL, exportMain, ex)) {
+#ifdef HAVE_IO_URING
+      if (ex->engine == ENGINE_URING) {
+         uringFree(&ex->ring);
+      }
+#endif
+      pthread_mutex_destroy(&ex->lock);
+      pthread_cond_destroy(&ex->cond);
+      close(ex->fd);
+      free(ex);
+      errno = EAGAIN;
+      return(NULL);
+   }
+   return(ex);
+} // End exportOpen
+
+
+/****************************************************************************
+  Report a finished chunk, called by the workers.  Only queues the chunk,
+  the write happens on the writer thread.
+
+  void exportChunk(struct Export_s *ex, long begin, long end)
+  Where: struct Export_s *ex - the exporter
+         long begin          - first element index of the chunk
+         long end            - one past the last element index
+  Returns: nothing
+  Errors: a failed queue allocation is reported by exportClose()
+****************************************************************************/
+void exportChunk(struct Export_s *ex, long begin, long end) {
+   pthread_mutex_lock(&ex->lock);
+   if (ex->queued == ex->queueCap) {
+      long cap = (ex->queueCap == 0) ? 1024 : 2*ex->queueCap;
+      struct Range_s *q = realloc(ex->queue, cap*sizeof(*q));
+
+      if (q == NULL) {
+         ex->error = (ex->error == 0) ? ENOMEM : ex->error;
+         pthread_mutex_unlock(&ex->lock);
+         return;
+      }
+      ex->queue = q;
+      ex->queueCap = cap;
+   }
+   ex->queue[ex->queued].begin = begin;
+   ex->queue[ex->queued].end = end;
+   ex->queued++;
+   pthread_cond_signal(&ex->cond);
+   pthread_mutex_unlock(&ex->lock);
+} // End exportChunk
+
+
+/****************************************************************************
+  Wait for all the reported chunks to be written and close the output
+
+  int exportClose(struct Export_s *ex)
+  Where: struct Export_s *ex - the exporter
+  Returns: int - 0 on success, -1 with errno set if any write failed
+  Errors: none
+****************************************************************************/
+int exportClose(struct Export_s *ex) {
+   int err;
+
+   pthread_mutex_lock(&ex->lock);
+   ex->closing = 1;
+   pthread_cond_signal(&ex->cond);
+   pthread_mutex_unlock(&ex->lock);
+   pthread_join(ex->writer, NULL);
+
+   err = ex->error;
+   if (err == 0 && ex->engine == ENGINE_WRITEV && ex->numPending > 0) {
+      err = EIO;   // Some chunk was never reported, the stream has a gap
+   }
+   if (close(ex->fd) && err == 0) {
+      err = errno;
+   }
+#ifdef HAVE_IO_URING
+   if (ex->engine == ENGINE_URING) {
+      uringFree(&ex->ring);
+   }
+#endif
+   pthread_mutex_destroy(&ex->lock);
+   pthread_cond_destroy(&ex->cond);
+   free(ex->queue);
+   free(ex->spare);
+   free(ex->pending);
+   free(ex);
+   errno = err;
+   return((err == 0) ? 0 : -1);
+} // End exportClose
+
+
+/****************************************************************************
+  Name the write engine in use
+
+  const char *exportEngine(struct Export_s *ex)
+  Where: struct Export_s *ex - the exporter
+  Returns: const char * - io_uring, pwritev or writev
+  Errors: none
+****************************************************************************/
+const char *exportEngine(struct Export_s *ex) {
+   return(engineNames[ex->engine]);
+} // End exportEngine
+
+
+/****************************************************************************
+  The writer thread.  Takes all the queued chunks at once, leaving an empty
+  queue to the workers, and writes them with the engine of the output.
+****************************************************************************/
+static void *exportMain(void *data) {
+   struct Export_s *ex = data;
+   struct Range_s *batch;
+   long n, cap;
+
+   pthread_mutex_lock(&ex->lock);
+   for (;;) {
+      while (ex->queued == 0 && !ex->closing) {
+         pthread_cond_wait(&ex->cond, &ex->lock);
+      }
+      if (ex->queued == 0) {
+         break;
+      }
+      // Swap the queue with the spare buffer
+      batch = ex->queue;
+      cap = ex->queueCap;
+      n = ex->queued;
+      ex->queue = ex->spare;
+      ex->queueCap = ex->spareCap;
+      ex->queued = 0;
+      ex->spare = batch;
+      ex->spareCap = cap;
+      pthread_mutex_unlock(&ex->lock);
+
+      if (ex->engine == ENGINE_WRITEV) {
+         writeInOrder(ex, batch, n);
+      }
+      else {
+         writeRuns(ex, batch, n);
+      }
+      pthread_mutex_lock(&ex->lock);
+   } // End for ever
+   pthread_mutex_unlock(&ex->lock);
+
+#ifdef HAVE_IO_URING
+   while (ex->engine == ENGINE_URING && ex->ring.inflight > 0) {
+      uringReap(ex, 1);
+   }
+#endif
+   return(NULL);
+} // End exportMain
+
+
+/****************************************************************************
+  Record the first write error, later chunks are then dropped
+****************************************************************************/
+static void setError(struct Export_s *ex, int err) {
+   pthread_mutex_lock(&ex->lock);
+   if (ex->error == 0) {
+      ex->error = err;
+   }
+   pthread_mutex_unlock(&ex->lock);
+} // End setError
+
+
+/****************************************************************************
+  Write a batch of chunks at their own file offsets.  Chunks that follow
+  each other are merged into one run and written with one call.
+****************************************************************************/
+static void writeRuns(struct Export_s *ex, struct Range_s *r, long n) {
+   struct iovec iov[IOV_MAX];
+
+   qsort(r, n, sizeof(*r), compareRange);
+   for (long i = 0; i < n && ex->error == 0; ) {
+      long runBegin = r[i].begin;
+      int numIov = 0;
+
+      // Collect the chunks of this run, one iovec each
+      do {
+         iov[numIov].iov_base = (void *)(ex->base + r[i].begin*ex->elemSize);
+         iov[numIov].iov_len = (r[i].end - r[i].begin)*ex->elemSize;
+         numIov++;
+         i++;
+      } while (i < n && r[i].begin == r[i-1].end && numIov < IOV_MAX);
+
+#ifdef HAVE_IO_URING
+      if (ex->engine == ENGINE_URING) {
+         // The run is contiguous in memory, hand it out in large pieces
+         char *p = (char *)iov[0].iov_base;
+         size_t left = (r[i-1].end - runBegin)*ex->elemSize;
+         off_t off = (off_t)(runBegin*ex->elemSize);
+
+         while (left > 0) {
+            size_t len = (left > URING_MAX_IO) ? URING_MAX_IO : left;
+            uringSubmit(ex, off, p, len);
+            p += len;
+            off += len;
+            left -= len;
+         }
+         continue;
+      }
+#endif
+      // pwritev() may write less than asked, skip what was done and retry
+      off_t off = (off_t)(runBegin*ex->elemSize);
+      struct iovec *v = iov;
+      while (numIov > 0) {
+         ssize_t done = pwritev(ex->fd, v, numIov, off);
+         if (done < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            setError(ex, errno);
+            return;
+         }
+         off += done;
+         while (numIov > 0 && (size_t)done >= v->iov_len) {
+            done -= v->iov_len;
+            v++;
+            numIov--;
+         }
+         if (numIov > 0) {
+            v->iov_base = (char *)v->iov_base + done;
+            v->iov_len -= done;
+         }
+      } // End while
+   } // End for runs
+} // End writeRuns
+
+
+/****************************************************************************
+  Write a batch of chunks to a pipe in index order.  Chunks after a gap are
+  kept in the sorted pending list until the gap is filled.
+****************************************************************************/
+static void writeInOrder(struct Export_s *ex, struct Range_s *r, long n) {
+   struct iovec iov[IOV_MAX];
+   long used = 0;
+
+   // Merge the batch into the pending list
+   if (ex->numPending + n > ex->pendingCap) {
+      long cap = 2*(ex->numPending + n);
+      struct Range_s *p = realloc(ex->pending, cap*sizeof(*p));
+      if (p == NULL) {
+         setError(ex, ENOMEM);
+         return;
+      }
+      ex->pending = p;
+      ex->pendingCap = cap;
+   }
+   memcpy(&ex->pending[ex->numPending], r, n*sizeof(*r));
+   ex->numPending += n;
+   qsort(ex->pending, ex->numPending, sizeof(*r), compareRange);
+
+   // Write everything that follows on from the last written element
+   while (used < ex->numPending && ex->pending[used].begin == ex->next &&
+          ex->error == 0) {
+      int numIov = 0;
+      struct iovec *v = iov;
+
+      while (used < ex->numPending && ex->pending[used].begin == ex->next &&
+             numIov < IOV_MAX) {
+         iov[numIov].iov_base = (void *)(ex->base + ex->pending[used].begin*ex->elemSize);
+         iov[numIov].iov_len = (ex->pending[used].end - ex->pending[used].begin)*ex->elemSize;
+         ex->next = ex->pending[used].end;
+         numIov++;
+         used++;
+      }
+      while (numIov > 0) {
+         ssize_t done = writev(ex->fd, v, numIov);
+         if (done < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            setError(ex, errno);
+            return;
+         }
+         while (numIov > 0 && (size_t)done >= v->iov_len) {
+            done -= v->iov_len;
+            v++;
+            numIov--;
+         }
+         if (numIov > 0) {
+            v->iov_base = (char *)v->iov_base + done;
+            v->iov_len -= done;
+         }
+      } // End while
+   } // End while in order
+
+   // Drop what was written from the pending list
+   memmove(ex->pending, &ex->pending[used], (ex->numPending - used)*sizeof(*r));
+   ex->numPending -= used;
+} // End writeInOrder
+
+
+/****************************************************************************
+  qsort() comparison of two chunks by their first index
+****************************************************************************/
+static int compareRange(const void *a, const void *b) {
+   long x = ((const struct Range_s *)a)->begin;
+   long y = ((const struct Range_s *)b)->begin;
+
+   return((x > y) - (x < y));
+} // End compareRange
+
+
+#ifdef HAVE_IO_URING
+/****************************************************************************
+  Set up an io_uring instance and map its rings
+
+  Returns: int - 0 on success, -1 if io_uring is not available
+****************************************************************************/
+static int uringInit(struct Uring_s *ring) {
+   struct io_uring_params p;
+   char *sq, *cq;
+
+   memset(ring, 0, sizeof(*ring));
+   memset(&p, 0, sizeof(p));
+   ring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+   if (ring->fd < 0) {
+      return(-1);
+   }
+
+   ring->sqRingSize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+   ring->cqRingSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+   ring->sqesSize = p.sq_entries*sizeof(struct io_uring_sqe);
+   ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+   ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+   ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+   if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED ||
+       ring->sqes == MAP_FAILED) {
+      uringFree(ring);
+      return(-1);
+   }
+
+   sq = ring->sqRing;
+   cq = ring->cqRing;
+   ring->sqHead = (unsigned *)(sq + p.sq_off.head);
+   ring->sqTail = (unsigned *)(sq + p.sq_off.tail);
+   ring->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+   ring->sqArray = (unsigned *)(sq + p.sq_off.array);
+   ring->cqHead = (unsigned *)(cq + p.cq_off.head);
+   ring->cqTail = (unsigned *)(cq + p.cq_off.tail);
+   ring->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+   ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+   for (int i = 0; i < URING_ENTRIES; i++) {
+      ring->reqs[i].next = (i + 1 < URING_ENTRIES) ? i + 1 : -1;
+   }
+   ring->freeReq = 0;
+   return(0);
+} // End uringInit
+
+
+/****************************************************************************
+  Queue one write, waiting for a completion first if all requests are in
+  flight
+****************************************************************************/
+static void uringSubmit(struct Export_s *ex, off_t off, char *data, size_t len) {
+   struct Uring_s *ring = &ex->ring;
+   struct UringReq_s *req;
+   struct io_uring_sqe *sqe;
+   unsigned tail;
+   int slot;
+
+   while (ring->freeReq < 0) {
+      uringReap(ex, 1);
+   }
+   slot = ring->freeReq;
+   req = &ring->reqs[slot];
+   ring->freeReq = req->next;
+   req->iov.iov_base = data;
+   req->iov.iov_len = len;
+   req->off = off;
+
+   tail = *ring->sqTail;
+   sqe = &ring->sqes[tail & *ring->sqMask];
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = IORING_OP_WRITEV;
+   sqe->fd = ex->fd;
+   sqe->addr = (unsigned long)&req->iov;
+   sqe->len = 1;
+   sqe->off = off;
+   sqe->user_data = slot;
+   ring->sqArray[tail & *ring->sqMask] = tail & *ring->sqMask;
+   __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+   ring->inflight++;
+
+   while (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0) {
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+         setError(ex, errno);
+         break;
+      }
+      uringReap(ex, 0);
+   }
+   uringReap(ex, 0);
+} // End uringSubmit
+
+
+/****************************************************************************
+  Process the completed writes, optionally waiting for at least one.  A
+  short write is resubmitted for the rest of its data.
+****************************************************************************/
+static void uringReap(struct Export_s *ex, int wait) {
+   struct Uring_s *ring = &ex->ring;
+   unsigned head = *ring->cqHead;
+
+   if (wait && head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+      if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS,
+                  NULL, 0) < 0 && errno != EINTR) {
+         // The ring is unusable, forget what is in flight
+         setError(ex, errno);
+         ring->inflight = 0;
+         return;
+      }
+   }
+   while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+      int slot = (int)cqe->user_data;
+      struct UringReq_s *req = &ring->reqs[slot];
+      int res = cqe->res;
+
+      head++;
+      __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+      ring->inflight--;
+      req->next = ring->freeReq;
+      ring->freeReq = slot;
+
+      if (res < 0) {
+         setError(ex, -res);
+      }
+      else if ((size_t)res < req->iov.iov_len && ex->error == 0) {
+         uringSubmit(ex, req->off + res, (char *)req->iov.iov_base + res,
+                     req->iov.iov_len - res);
+         head = *ring->cqHead;
+      }
+   } // End while completions
+} // End uringReap
+
+
+/****************************************************************************
+  Unmap the rings and close the io_uring instance
+****************************************************************************/
+static void uringFree(struct Uring_s *ring) {
+   if (ring->sqRing != NULL && ring->sqRing != MAP_FAILED) {
+      munmap(ring->sqRing, ring->sqRingSize);
+   }
+   if (ring->cqRing != NULL && ring->cqRing != MAP_FAILED) {
+      munmap(ring->cqRing, ring->cqRingSize);
+   }
+   if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+      munmap(ring->sqes, ring->sqesSize);
+   }
+   close(ring->fd);
+} // End uringFree
+#endif /* HAVE_IO_URING */
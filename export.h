@@ -0,0 +1,29 @@
+/******************************************************************************
+* Asynchronous streaming export of the generated data
+*
+* The workers report every finished chunk with exportChunk() and go on
+* generating, a writer thread owned by the exporter writes the chunks to the
+* output while the fill continues.
+*
+*   regular file - chunks are written at their own offset in any order, with
+*                  io_uring when the kernel allows it, else with pwritev()
+*   pipe, fifo,  - chunks are written strictly in index order with writev(),
+*   device         out of order chunks wait until the gap before them is done
+*
+* The file holds the raw elements in native byte order.
+******************************************************************************/
+#ifndef _EXPORT_H_
+#define _EXPORT_H_
+
+#include <stddef.h>
+
+struct Export_s;
+
+/* Function prototypes */
+struct Export_s *exportOpen(const char *path, const void *base, size_t elemSize,
+                            long count);
+void exportChunk(struct Export_s *ex, long begin, long end);
+int exportClose(struct Export_s *ex);
+const char *exportEngine(struct Export_s *ex);
+
+#endif /* _EXPORT_H_ */
@@ -0,0 +1,626 @@
+//  Arithmetic progression fill kernels for hw13
+//
+//  The lane operations are picked for the element width at compile time,
+//  see WIDE_ELEM in fill.h.
+//  The vector kernels align the destination with scalar stores, then store
+//  four registers per iteration from four running lane vectors that are all
+//  advanced by the same increment vector, and finish the tail with scalar
+//  stores (masked stores for AVX-512).
+//
+//  The streaming variants are the same loops with non-temporal stores
+//  (movntdq), the head, tail and the AVX-512 masked store stay normal
+//  stores.  Streaming stores are weakly ordered, so each variant ends with
+//  an sfence before it returns and the chunk can be handed to another
+//  thread.
+//
+//  The verifiers OR together the differences of four registers and only
+//  branch once per block, a block with a difference is rescanned with the
+//  scalar verifier to find the exact position.
+
+#include <stdint.h>
+#include <string.h>
+#include "fill.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FILL_X86
+#include <immintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+static const char *kernelNames[] = {"scalar", "sse2", "avx2", "avx512"};
+#define NUM_KERNELS ((int)(sizeof(kernelNames)/sizeof(kernelNames[0])))
+
+#ifdef FILL_X86
+// Lane operations for the element width
+#ifdef WIDE_ELEM
+#define V128_ADD            _mm_add_epi64
+#define V128_SET1           _mm_set1_epi64x
+#define V256_ADD            _mm256_add_epi64
+#define V256_SET1           _mm256_set1_epi64x
+#define V512_ADD            _mm512_add_epi64
+#define V512_SET1           _mm512_set1_epi64
+#define V512_MASK_STORE     _mm512_mask_store_epi64
+#define V512_MASKZ_LOAD     _mm512_maskz_loadu_epi64
+#define V512_CMPNEQ         _mm512_cmpneq_epi64_mask
+#define V512_MASK_CMPNEQ    _mm512_mask_cmpneq_epi64_mask
+#define V512_TEST           _mm512_test_epi64_mask
+typedef __mmask8 Mask512_t;
+#else
+#define V128_ADD            _mm_add_epi32
+#define V128_SET1           _mm_set1_epi32
+#define V256_ADD            _mm256_add_epi32
+#define V256_SET1           _mm256_set1_epi32
+#define V512_ADD            _mm512_add_epi32
+#define V512_SET1           _mm512_set1_epi32
+#define V512_MASK_STORE     _mm512_mask_store_epi32
+#define V512_MASKZ_LOAD     _mm512_maskz_loadu_epi32
+#define V512_CMPNEQ         _mm512_cmpneq_epi32_mask
+#define V512_MASK_CMPNEQ    _mm512_mask_cmpneq_epi32_mask
+#define V512_TEST           _mm512_test_epi32_mask
+typedef __mmask16 Mask512_t;
+#endif
+
+// Elements per register
+#define L128 ((long)(16/sizeof(elem_t)))
+#define L256 ((long)(32/sizeof(elem_t)))
+#define L512 ((long)(64/sizeof(elem_t)))
+#endif /* FILL_X86 */
+
+
+/****************************************************************************
+  Scalar reference kernel
+****************************************************************************/
+static void fillScalar(elem_t *dst, long count, elem_t first, elem_t step) {
+   for (long k = 0; k < count; k++) {
+      dst[k] = AP_VALUE(first, step, k);
+   }
+} // End fillScalar
+
+
+/****************************************************************************
+  Scalar reference verifier, returns the first mismatch or count
+****************************************************************************/
+static long verifyScalar(const elem_t *src, long count, elem_t first, elem_t step) {
+   for (long k = 0; k < count; k++) {
+      if (src[k] != AP_VALUE(first, step, k)) {
+         return(k);
+      }
+   }
+   return(count);
+} // End verifyScalar
+
+
+#ifdef FILL_X86
+/****************************************************************************
+  Store the progression values k..k+n-1 in a scratch array, used to load
+  the starting lane registers
+****************************************************************************/
+static void laneValues(elem_t *lanes, long n, elem_t first, elem_t step, long k) {
+   for (long j = 0; j < n; j++) {
+      lanes[j] = AP_VALUE(first, step, k + j);
+   }
+} // End laneValues
+
+
+/****************************************************************************
+  SSE2 kernel, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("sse2")))
+static void fillSse2(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[16/sizeof(elem_t)] __attribute__((aligned(16)));
+   long k = 0;
+
+   // Scalar head up to the first 16 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 15)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (count - k >= 4*L128) {
+      laneValues(lanes, L128, first, step, k);
+      __m128i v0 = _mm_load_si128((const __m128i *)lanes);
+      __m128i v1 = V128_ADD(v0, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v2 = V128_ADD(v1, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v3 = V128_ADD(v2, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i inc = V128_SET1(AP_VALUE(0, step, 4*L128));
+
+      for (; k + 4*L128 <= count; k += 4*L128) {
+         _mm_store_si128((__m128i *)&dst[k],          v0);
+         _mm_store_si128((__m128i *)&dst[k+L128],     v1);
+         _mm_store_si128((__m128i *)&dst[k+2*L128],   v2);
+         _mm_store_si128((__m128i *)&dst[k+3*L128],   v3);
+         v0 = V128_ADD(v0, inc);
+         v1 = V128_ADD(v1, inc);
+         v2 = V128_ADD(v2, inc);
+         v3 = V128_ADD(v3, inc);
+      } // End for k
+   }
+   fillScalar(&dst[k], count - k, AP_VALUE(first, step, k), step);
+} // End fillSse2
+
+
+/****************************************************************************
+  AVX2 kernel, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("avx2")))
+static void fillAvx2(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[32/sizeof(elem_t)] __attribute__((aligned(32)));
+   long k = 0;
+
+   // Scalar head up to the first 32 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 31)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (count - k >= 4*L256) {
+      laneValues(lanes, L256, first, step, k);
+      __m256i v0 = _mm256_load_si256((const __m256i *)lanes);
+      __m256i v1 = V256_ADD(v0, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v2 = V256_ADD(v1, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v3 = V256_ADD(v2, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i inc = V256_SET1(AP_VALUE(0, step, 4*L256));
+
+      for (; k + 4*L256 <= count; k += 4*L256) {
+         _mm256_store_si256((__m256i *)&dst[k],        v0);
+         _mm256_store_si256((__m256i *)&dst[k+L256],   v1);
+         _mm256_store_si256((__m256i *)&dst[k+2*L256], v2);
+         _mm256_store_si256((__m256i *)&dst[k+3*L256], v3);
+         v0 = V256_ADD(v0, inc);
+         v1 = V256_ADD(v1, inc);
+         v2 = V256_ADD(v2, inc);
+         v3 = V256_ADD(v3, inc);
+      } // End for k
+   }
+   fillScalar(&dst[k], count - k, AP_VALUE(first, step, k), step);
+} // End fillAvx2
+
+
+/****************************************************************************
+  AVX-512 kernel, 4 registers per iteration.  The tail is written with
+  masked stores instead of a scalar loop.
+****************************************************************************/
+__attribute__((target("avx512f")))
+static void fillAvx512(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[64/sizeof(elem_t)] __attribute__((aligned(64)));
+   long k = 0;
+
+   // Scalar head up to the first 64 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 63)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (k >= count) {
+      return;
+   }
+   laneValues(lanes, L512, first, step, k);
+   __m512i v0 = _mm512_load_si512(lanes);
+   __m512i inc1 = V512_SET1(AP_VALUE(0, step, L512));
+   __m512i v1 = V512_ADD(v0, inc1);
+   __m512i v2 = V512_ADD(v1, inc1);
+   __m512i v3 = V512_ADD(v2, inc1);
+   __m512i inc = V512_SET1(AP_VALUE(0, step, 4*L512));
+
+   for (; k + 4*L512 <= count; k += 4*L512) {
+      _mm512_store_si512((void *)&dst[k],        v0);
+      _mm512_store_si512((void *)&dst[k+L512],   v1);
+      _mm512_store_si512((void *)&dst[k+2*L512], v2);
+      _mm512_store_si512((void *)&dst[k+3*L512], v3);
+      v0 = V512_ADD(v0, inc);
+      v1 = V512_ADD(v1, inc);
+      v2 = V512_ADD(v2, inc);
+      v3 = V512_ADD(v3, inc);
+   } // End for k
+
+   // Less than 4 registers left, one at a time then a masked store
+   for (; k + L512 <= count; k += L512) {
+      _mm512_store_si512((void *)&dst[k], v0);
+      v0 = V512_ADD(v0, inc1);
+   }
+   if (k < count) {
+      V512_MASK_STORE((void *)&dst[k], (Mask512_t)((1u << (count - k)) - 1), v0);
+   }
+} // End fillAvx512
+
+
+/****************************************************************************
+  SSE2 streaming store kernel, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("sse2")))
+static void fillSse2Nt(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[16/sizeof(elem_t)] __attribute__((aligned(16)));
+   long k = 0;
+
+   // Scalar head up to the first 16 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 15)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (count - k >= 4*L128) {
+      laneValues(lanes, L128, first, step, k);
+      __m128i v0 = _mm_load_si128((const __m128i *)lanes);
+      __m128i v1 = V128_ADD(v0, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v2 = V128_ADD(v1, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v3 = V128_ADD(v2, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i inc = V128_SET1(AP_VALUE(0, step, 4*L128));
+
+      for (; k + 4*L128 <= count; k += 4*L128) {
+         _mm_stream_si128((__m128i *)&dst[k],          v0);
+         _mm_stream_si128((__m128i *)&dst[k+L128],     v1);
+         _mm_stream_si128((__m128i *)&dst[k+2*L128],   v2);
+         _mm_stream_si128((__m128i *)&dst[k+3*L128],   v3);
+         v0 = V128_ADD(v0, inc);
+         v1 = V128_ADD(v1, inc);
+         v2 = V128_ADD(v2, inc);
+         v3 = V128_ADD(v3, inc);
+      } // End for k
+   }
+   fillScalar(&dst[k], count - k, AP_VALUE(first, step, k), step);
+   _mm_sfence();
+} // End fillSse2Nt
+
+
+/****************************************************************************
+  AVX2 streaming store kernel, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("avx2")))
+static void fillAvx2Nt(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[32/sizeof(elem_t)] __attribute__((aligned(32)));
+   long k = 0;
+
+   // Scalar head up to the first 32 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 31)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (count - k >= 4*L256) {
+      laneValues(lanes, L256, first, step, k);
+      __m256i v0 = _mm256_load_si256((const __m256i *)lanes);
+      __m256i v1 = V256_ADD(v0, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v2 = V256_ADD(v1, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v3 = V256_ADD(v2, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i inc = V256_SET1(AP_VALUE(0, step, 4*L256));
+
+      for (; k + 4*L256 <= count; k += 4*L256) {
+         _mm256_stream_si256((__m256i *)&dst[k],        v0);
+         _mm256_stream_si256((__m256i *)&dst[k+L256],   v1);
+         _mm256_stream_si256((__m256i *)&dst[k+2*L256], v2);
+         _mm256_stream_si256((__m256i *)&dst[k+3*L256], v3);
+         v0 = V256_ADD(v0, inc);
+         v1 = V256_ADD(v1, inc);
+         v2 = V256_ADD(v2, inc);
+         v3 = V256_ADD(v3, inc);
+      } // End for k
+   }
+   fillScalar(&dst[k], count - k, AP_VALUE(first, step, k), step);
+   _mm_sfence();
+} // End fillAvx2Nt
+
+
+/****************************************************************************
+  AVX-512 streaming store kernel, 4 registers per iteration, whole lines
+  are streamed and the tail is a normal masked store
+****************************************************************************/
+__attribute__((target("avx512f")))
+static void fillAvx512Nt(elem_t *dst, long count, elem_t first, elem_t step) {
+   elem_t lanes[64/sizeof(elem_t)] __attribute__((aligned(64)));
+   long k = 0;
+
+   // Scalar head up to the first 64 byte boundary
+   while (k < count && ((uintptr_t)&dst[k] & 63)) {
+      dst[k] = AP_VALUE(first, step, k);
+      k++;
+   }
+   if (k >= count) {
+      return;
+   }
+   laneValues(lanes, L512, first, step, k);
+   __m512i v0 = _mm512_load_si512(lanes);
+   __m512i inc1 = V512_SET1(AP_VALUE(0, step, L512));
+   __m512i v1 = V512_ADD(v0, inc1);
+   __m512i v2 = V512_ADD(v1, inc1);
+   __m512i v3 = V512_ADD(v2, inc1);
+   __m512i inc = V512_SET1(AP_VALUE(0, step, 4*L512));
+
+   for (; k + 4*L512 <= count; k += 4*L512) {
+      _mm512_stream_si512((void *)&dst[k],        v0);
+      _mm512_stream_si512((void *)&dst[k+L512],   v1);
+      _mm512_stream_si512((void *)&dst[k+2*L512], v2);
+      _mm512_stream_si512((void *)&dst[k+3*L512], v3);
+      v0 = V512_ADD(v0, inc);
+      v1 = V512_ADD(v1, inc);
+      v2 = V512_ADD(v2, inc);
+      v3 = V512_ADD(v3, inc);
+   } // End for k
+
+   // Less than 4 registers left, one at a time then a masked store
+   for (; k + L512 <= count; k += L512) {
+      _mm512_stream_si512((void *)&dst[k], v0);
+      v0 = V512_ADD(v0, inc1);
+   }
+   if (k < count) {
+      V512_MASK_STORE((void *)&dst[k], (Mask512_t)((1u << (count - k)) - 1), v0);
+   }
+   _mm_sfence();
+} // End fillAvx512Nt
+
+
+/****************************************************************************
+  SSE2 verifier, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("sse2")))
+static long verifySse2(const elem_t *src, long count, elem_t first, elem_t step) {
+   elem_t lanes[16/sizeof(elem_t)] __attribute__((aligned(16)));
+   long k = 0;
+
+   if (count >= 4*L128) {
+      laneValues(lanes, L128, first, step, 0);
+      __m128i v0 = _mm_load_si128((const __m128i *)lanes);
+      __m128i v1 = V128_ADD(v0, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v2 = V128_ADD(v1, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i v3 = V128_ADD(v2, V128_SET1(AP_VALUE(0, step, L128)));
+      __m128i inc = V128_SET1(AP_VALUE(0, step, 4*L128));
+
+      for (; k + 4*L128 <= count; k += 4*L128) {
+         __m128i diff = _mm_or_si128(
+            _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[k]),        v0),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[k+L128]),   v1)),
+            _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[k+2*L128]), v2),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[k+3*L128]), v3)));
+         if (_mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) != 0xFFFF) {
+            return(k + verifyScalar(&src[k], 4*L128, AP_VALUE(first, step, k), step));
+         }
+         v0 = V128_ADD(v0, inc);
+         v1 = V128_ADD(v1, inc);
+         v2 = V128_ADD(v2, inc);
+         v3 = V128_ADD(v3, inc);
+      } // End for k
+   }
+   return(k + verifyScalar(&src[k], count - k, AP_VALUE(first, step, k), step));
+} // End verifySse2
+
+
+/****************************************************************************
+  AVX2 verifier, 4 registers per iteration
+****************************************************************************/
+__attribute__((target("avx2")))
+static long verifyAvx2(const elem_t *src, long count, elem_t first, elem_t step) {
+   elem_t lanes[32/sizeof(elem_t)] __attribute__((aligned(32)));
+   long k = 0;
+
+   if (count >= 4*L256) {
+      laneValues(lanes, L256, first, step, 0);
+      __m256i v0 = _mm256_load_si256((const __m256i *)lanes);
+      __m256i v1 = V256_ADD(v0, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v2 = V256_ADD(v1, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i v3 = V256_ADD(v2, V256_SET1(AP_VALUE(0, step, L256)));
+      __m256i inc = V256_SET1(AP_VALUE(0, step, 4*L256));
+
+      for (; k + 4*L256 <= count; k += 4*L256) {
+         __m256i diff = _mm256_or_si256(
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&src[k]),        v0),
+                            _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&src[k+L256]),   v1)),
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&src[k+2*L256]), v2),
+                            _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&src[k+3*L256]), v3)));
+         if (!_mm256_testz_si256(diff, diff)) {
+            return(k + verifyScalar(&src[k], 4*L256, AP_VALUE(first, step, k), step));
+         }
+         v0 = V256_ADD(v0, inc);
+         v1 = V256_ADD(v1, inc);
+         v2 = V256_ADD(v2, inc);
+         v3 = V256_ADD(v3, inc);
+      } // End for k
+   }
+   return(k + verifyScalar(&src[k], count - k, AP_VALUE(first, step, k), step));
+} // End verifyAvx2
+
+
+/****************************************************************************
+  AVX-512 verifier, 4 registers per iteration, masked compare for the tail
+****************************************************************************/
+__attribute__((target("avx512f")))
+static long verifyAvx512(const elem_t *src, long count, elem_t first, elem_t step) {
+   elem_t lanes[64/sizeof(elem_t)] __attribute__((aligned(64)));
+   long k = 0;
+   Mask512_t bad;
+
+   laneValues(lanes, L512, first, step, 0);
+   __m512i v0 = _mm512_load_si512(lanes);
+   __m512i inc1 = V512_SET1(AP_VALUE(0, step, L512));
+   __m512i v1 = V512_ADD(v0, inc1);
+   __m512i v2 = V512_ADD(v1, inc1);
+   __m512i v3 = V512_ADD(v2, inc1);
+   __m512i inc = V512_SET1(AP_VALUE(0, step, 4*L512));
+
+   for (; k + 4*L512 <= count; k += 4*L512) {
+      __m512i diff = _mm512_or_si512(
+         _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(&src[k]),        v0),
+                         _mm512_xor_si512(_mm512_loadu_si512(&src[k+L512]),   v1)),
+         _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(&src[k+2*L512]), v2),
+                         _mm512_xor_si512(_mm512_loadu_si512(&src[k+3*L512]), v3)));
+      if (V512_TEST(diff, diff)) {
+         return(k + verifyScalar(&src[k], 4*L512, AP_VALUE(first, step, k), step));
+      }
+      v0 = V512_ADD(v0, inc);
+      v1 = V512_ADD(v1, inc);
+      v2 = V512_ADD(v2, inc);
+      v3 = V512_ADD(v3, inc);
+   } // End for k
+
+   // Less than 4 registers left, one at a time then a masked compare
+   for (; k + L512 <= count; k += L512) {
+      bad = V512_CMPNEQ(_mm512_loadu_si512(&src[k]), v0);
+      if (bad) {
+         return(k + __builtin_ctz(bad));
+      }
+      v0 = V512_ADD(v0, inc1);
+   }
+   if (k < count) {
+      Mask512_t tail = (Mask512_t)((1u << (count - k)) - 1);
+      bad = V512_MASK_CMPNEQ(tail, V512_MASKZ_LOAD(tail, &src[k]), v0);
+      if (bad) {
+         return(k + __builtin_ctz(bad));
+      }
+   }
+   return(count);
+} // End verifyAvx512
+#endif /* FILL_X86 */
+
+
+/****************************************************************************
+  Return the fill routine of a kernel
+
+  FillFn_t fillFunc(int kernel)
+  Where: int kernel - one of the KERNEL_xxx values, KERNEL_AUTO for the best
+  Returns: FillFn_t - the kernel, the scalar kernel if it is not built in
+  Errors: none
+****************************************************************************/
+FillFn_t fillFunc(int kernel) {
+   if (kernel == KERNEL_AUTO) {
+      kernel = fillBest();
+   }
+   switch (kernel) {
+#ifdef FILL_X86
+      case KERNEL_SSE2:
+      return(fillSse2);
+      case KERNEL_AVX2:
+      return(fillAvx2);
+      case KERNEL_AVX512:
+      return(fillAvx512);
+#endif
+      default:
+      return(fillScalar);
+   } // End switch
+} // End fillFunc
+
+
+/****************************************************************************
+  Return the streaming store variant of a kernel, the scalar kernel has
+  none and is returned as it is
+
+  FillFn_t fillStreamFunc(int kernel)
+  Where: int kernel - one of the KERNEL_xxx values, KERNEL_AUTO for the best
+  Returns: FillFn_t - the kernel, the scalar kernel if it is not built in
+  Errors: none
+****************************************************************************/
+FillFn_t fillStreamFunc(int kernel) {
+   if (kernel == KERNEL_AUTO) {
+      kernel = fillBest();
+   }
+   switch (kernel) {
+#ifdef FILL_X86
+      case KERNEL_SSE2:
+      return(fillSse2Nt);
+      case KERNEL_AVX2:
+      return(fillAvx2Nt);
+      case KERNEL_AVX512:
+      return(fillAvx512Nt);
+#endif
+      default:
+      return(fillScalar);
+   } // End switch
+} // End fillStreamFunc
+
+
+/****************************************************************************
+  Return the verifier matching a fill kernel
+
+  VerifyFn_t verifyFunc(int kernel)
+  Where: int kernel - one of the KERNEL_xxx values, KERNEL_AUTO for the best
+  Returns: VerifyFn_t - the verifier, the scalar one if it is not built in
+  Errors: none
+****************************************************************************/
+VerifyFn_t verifyFunc(int kernel) {
+   if (kernel == KERNEL_AUTO) {
+      kernel = fillBest();
+   }
+   switch (kernel) {
+#ifdef FILL_X86
+      case KERNEL_SSE2:
+      return(verifySse2);
+      case KERNEL_AVX2:
+      return(verifyAvx2);
+      case KERNEL_AVX512:
+      return(verifyAvx512);
+#endif
+      default:
+      return(verifyScalar);
+   } // End switch
+} // End verifyFunc
+
+
+/****************************************************************************
+  Check if this CPU can run a kernel
+
+  int fillSupported(int kernel)
+  Where: int kernel - one of the KERNEL_xxx values
+  Returns: int - 1 if supported, 0 if not
+  Errors: none
+****************************************************************************/
+int fillSupported(int kernel) {
+   switch (kernel) {
+      case KERNEL_SCALAR:
+      return(1);
+#ifdef FILL_X86
+      case KERNEL_SSE2:
+      return(__builtin_cpu_supports("sse2") != 0);
+      case KERNEL_AVX2:
+      return(__builtin_cpu_supports("avx2") != 0);
+      case KERNEL_AVX512:
+      return(__builtin_cpu_supports("avx512f") != 0);
+#endif
+      default:
+      return(0);
+   } // End switch
+} // End fillSupported
+
+
+/****************************************************************************
+  Pick the widest kernel this CPU supports
+
+  int fillBest(void)
+  Returns: int - one of the KERNEL_xxx values
+  Errors: none
+****************************************************************************/
+int fillBest(void) {
+   for (int kernel = NUM_KERNELS - 1; kernel > KERNEL_SCALAR; kernel--) {
+      if (fillSupported(kernel)) {
+         return(kernel);
+      }
+   }
+   return(KERNEL_SCALAR);
+} // End fillBest
+
+
+/****************************************************************************
+  Convert between kernel names and values
+
+  int fillKernel(const char *name)
+  Where: const char *name - auto, scalar, sse2, avx2 or avx512
+  Returns: int - the KERNEL_xxx value, -2 if unknown
+
+  const char *fillName(int kernel)
+  Where: int kernel - one of the KERNEL_xxx values
+  Returns: const char * - the kernel name
+****************************************************************************/
+int fillKernel(const char *name) {
+   if (strcmp(name, "auto") == 0) {
+      return(KERNEL_AUTO);
+   }
+   for (int i = 0; i < NUM_KERNELS; i++) {
+      if (strcmp(name, kernelNames[i]) == 0) {
+         return(i);
+      }
+   }
+   return(-2);
+} // End fillKernel
+
+const char *fillName(int kernel) {
+   if (kernel == KERNEL_AUTO) {
+      return("auto");
+   }
+   if (kernel < 0 || kernel >= NUM_KERNELS) {
+      return("unknown");
+   }
+   return(kernelNames[kernel]);
+} // End fillName
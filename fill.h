@@ -0,0 +1,63 @@
+/******************************************************************************
+* Arithmetic progression fill kernels for hw13
+*
+* Every kernel writes dst[k] = first + k*step for k = 0..count-1 with
+* wrap-around arithmetic in the element type.  Elements are 32 bit ints, or
+* 64 bit when built with -DWIDE_ELEM (make WIDE=1); indexes and counts are
+* always 64 bit so the array may hold more than 2^31 elements.  The vector
+* kernels keep a register of lane values and an increment register and
+* store whole registers, the scalar kernel is the reference and handles the
+* unaligned head and tail of the vector ones.
+*
+* Each kernel has a matching verifier that compares memory against the same
+* progression a whole register at a time and returns the position of the
+* first mismatch.
+*
+* Every vector kernel also has a streaming store variant (fillStreamFunc)
+* that writes with non-temporal stores, which skip the read for ownership
+* of the destination lines and do not evict other data from the cache.
+* That pays off for data that is not read again soon, the variants fence
+* their stores before they return.
+*
+* The kernel is chosen once at startup: fillBest() picks the widest kernel
+* the CPU supports (cpuid via __builtin_cpu_supports), or a specific kernel
+* can be forced by name.
+******************************************************************************/
+#ifndef _FILL_H_
+#define _FILL_H_
+
+#include <stdint.h>
+
+/* Element type of the data array */
+#ifdef WIDE_ELEM
+   typedef int64_t elem_t;
+   typedef uint64_t uelem_t;
+#else
+   typedef int32_t elem_t;
+   typedef uint32_t uelem_t;
+#endif
+
+/* Value k of the progression first + k*step, computed unsigned so it wraps */
+#define AP_VALUE(first, step, k) \
+   ((elem_t)((uelem_t)(first) + (uelem_t)(k)*(uelem_t)(step)))
+
+/* Fill kernels, in increasing width */
+#define KERNEL_SCALAR       (0)
+#define KERNEL_SSE2         (1)
+#define KERNEL_AVX2         (2)
+#define KERNEL_AVX512       (3)
+#define KERNEL_AUTO         (-1)
+
+typedef void (*FillFn_t)(elem_t *dst, long count, elem_t first, elem_t step);
+typedef long (*VerifyFn_t)(const elem_t *src, long count, elem_t first, elem_t step);
+
+/* Function prototypes */
+FillFn_t fillFunc(int kernel);
+FillFn_t fillStreamFunc(int kernel);
+VerifyFn_t verifyFunc(int kernel);
+int fillSupported(int kernel);
+int fillBest(void);
+int fillKernel(const char *name);
+const char *fillName(int kernel);
+
+#endif /* _FILL_H_ */
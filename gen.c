@@ -0,0 +1,393 @@
+//  Generator kernels for hw13
+//
+//  genFill() is the fast path used by the workers, genValue() computes a
+//  single element and is the reference the verifier and the error report
+//  use.  The Philox kernel has a scalar and an AVX2 version producing the
+//  same blocks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "gen.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GEN_X86
+#include <immintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+static const char *genNames[] = {"affine", "poly", "philox"};
+#define NUM_GENS ((int)(sizeof(genNames)/sizeof(genNames[0])))
+
+// Philox4x32-10 multipliers and key increments
+#define PHILOX_M0           (0xD2511F53u)
+#define PHILOX_M1           (0xCD9E8D57u)
+#define PHILOX_W0           (0x9E3779B9u)
+#define PHILOX_W1           (0xBB67AE85u)
+#define PHILOX_ROUNDS       (10)
+
+// Counters per block and elements per block: each counter gives 128 bits
+#define PHILOX_LANES        (8)
+#define BLOCK_ELEMS         ((long)(PHILOX_LANES*16/sizeof(elem_t)))
+
+// Elements generated at a time by the verifier
+#define VERIFY_ELEMS        (1024)
+
+
+/****************************************************************************
+  One Philox4x32-10 evaluation
+****************************************************************************/
+static void philox(const uint32_t key[2], uint64_t counter, uint32_t w[4]) {
+   uint32_t c0 = (uint32_t)counter, c1 = (uint32_t)(counter >> 32), c2 = 0, c3 = 0;
+   uint32_t k0 = key[0], k1 = key[1];
+
+   for (int r = 0; r < PHILOX_ROUNDS; r++) {
+      uint64_t p0 = (uint64_t)PHILOX_M0*c0;
+      uint64_t p1 = (uint64_t)PHILOX_M1*c2;
+
+      c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+      c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t)p1;
+      c3 = (uint32_t)p0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+   w[0] = c0;
+   w[1] = c1;
+   w[2] = c2;
+   w[3] = c3;
+} // End philox
+
+
+/****************************************************************************
+  Element r of a block from the words of its counter.  Element r belongs
+  to counter r%8, 32 bit elements take word r/8, 64 bit elements the word
+  pair r/8.
+****************************************************************************/
+static elem_t philoxElem(const uint32_t w[4], long r) {
+#ifdef WIDE_ELEM
+   long p = r/PHILOX_LANES;
+   return((elem_t)((uint64_t)w[2*p] | ((uint64_t)w[2*p + 1] << 32)));
+#else
+   return((elem_t)w[r/PHILOX_LANES]);
+#endif
+} // End philoxElem
+
+
+/****************************************************************************
+  Fill one whole block, scalar version
+****************************************************************************/
+static void philoxBlock(const uint32_t key[2], long block, elem_t *dst) {
+   uint32_t w[4];
+
+   for (int lane = 0; lane < PHILOX_LANES; lane++) {
+      philox(key, (uint64_t)block*PHILOX_LANES + lane, w);
+      for (long r = lane; r < BLOCK_ELEMS; r += PHILOX_LANES) {
+         dst[r] = philoxElem(w, r);
+      }
+   }
+} // End philoxBlock
+
+
+#ifdef GEN_X86
+/****************************************************************************
+  32x32 bit multiply of the eight lanes, high and low halves
+****************************************************************************/
+__attribute__((target("avx2")))
+static inline void mulHiLo(__m256i a, __m256i m, __m256i *hi, __m256i *lo) {
+   __m256i even = _mm256_mul_epu32(a, m);
+   __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+   *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+   *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+} // End mulHiLo
+
+
+/****************************************************************************
+  Fill whole blocks, the eight counters of a block run in the lanes of
+  four registers, one per word
+****************************************************************************/
+__attribute__((target("avx2")))
+static void philoxBlocksAvx2(const uint32_t key[2], long block, long numBlocks,
+                             elem_t *dst) {
+   const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+   const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+   const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+   for (long b = 0; b < numBlocks; b++, dst += BLOCK_ELEMS) {
+      // The low word of block*8 ends in three zero bits, adding the lane
+      // number can not carry into the high word
+      uint64_t base = (uint64_t)(block + b)*PHILOX_LANES;
+      __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)base), lanes);
+      __m256i c1 = _mm256_set1_epi32((int)(uint32_t)(base >> 32));
+      __m256i c2 = _mm256_setzero_si256();
+      __m256i c3 = _mm256_setzero_si256();
+      uint32_t k0 = key[0], k1 = key[1];
+
+      for (int r = 0; r < PHILOX_ROUNDS; r++) {
+         __m256i hi0, lo0, hi1, lo1;
+
+         mulHiLo(c0, m0, &hi0, &lo0);
+         mulHiLo(c2, m1, &hi1, &lo1);
+         c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+         c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+         c1 = lo1;
+         c3 = lo0;
+         k0 += PHILOX_W0;
+         k1 += PHILOX_W1;
+      }
+
+#ifdef WIDE_ELEM
+      // Pair the words, unpack works within 128 bit halves so the counters
+      // come out as 0,1,4,5 and 2,3,6,7 and are put back in order
+      __m256i lo = _mm256_unpacklo_epi32(c0, c1);
+      __m256i hi = _mm256_unpackhi_epi32(c0, c1);
+      _mm256_storeu_si256((__m256i *)&dst[0], _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)&dst[4], _mm256_permute2x128_si256(lo, hi, 0x31));
+      lo = _mm256_unpacklo_epi32(c2, c3);
+      hi = _mm256_unpackhi_epi32(c2, c3);
+      _mm256_storeu_si256((__m256i *)&dst[8], _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)&dst[12], _mm256_permute2x128_si256(lo, hi, 0x31));
+#else
+      _mm256_storeu_si256((__m256i *)&dst[0], c0);
+      _mm256_storeu_si256((__m256i *)&dst[8], c1);
+      _mm256_storeu_si256((__m256i *)&dst[16], c2);
+      _mm256_storeu_si256((__m256i *)&dst[24], c3);
+#endif
+   } // End for blocks
+} // End philoxBlocksAvx2
+#endif /* GEN_X86 */
+
+
+/****************************************************************************
+  Parse a generator spec
+
+  int genParse(struct Gen_s *gen, const char *spec)
+  Where: struct Gen_s *gen - receives the generator
+         const char *spec  - affine[:a[,b]], poly:c0[,c1...] or philox[:seed]
+  Returns: int - 0 on success, -1 if the spec is not valid
+  Errors: none
+****************************************************************************/
+int genParse(struct Gen_s *gen, const char *spec) {
+   const char *args = strchr(spec, ':');
+   size_t len = (args != NULL) ? (size_t)(args - spec) : strlen(spec);
+   long long num[GEN_MAX_DEGREE + 1];
+   int n = 0;
+
+   memset(gen, 0, sizeof(*gen));
+   gen->type = -1;
+   for (int i = 0; i < NUM_GENS; i++) {
+      if (strlen(genNames[i]) == len && strncmp(spec, genNames[i], len) == 0) {
+         gen->type = i;
+      }
+   }
+   if (gen->type < 0) {
+      return(-1);
+   }
+
+   // Comma separated numbers, any base strtoll() takes
+   if (args != NULL) {
+      const char *p = args + 1;
+      char *end;
+
+      do {
+         if (n > GEN_MAX_DEGREE) {
+            return(-1);
+         }
+         if (gen->type == GEN_PHILOX) {
+            num[n++] = (long long)strtoull(p, &end, 0);
+         }
+         else {
+            num[n++] = strtoll(p, &end, 0);
+         }
+         if (end == p || (*end != ',' && *end != '\0')) {
+            return(-1);
+         }
+         p = end + 1;
+      } while (*end == ',');
+   }
+
+   switch (gen->type) {
+      case GEN_AFFINE:
+      if (n > 2) {
+         return(-1);
+      }
+      gen->degree = 1;
+      gen->coef[1] = (n > 0) ? (elem_t)num[0] : GEN_AFFINE_STEP;
+      gen->coef[0] = (n > 1) ? (elem_t)num[1] : 0;
+      break;
+
+      case GEN_POLY:
+      if (n == 0) {
+         return(-1);
+      }
+      gen->degree = n - 1;
+      for (int k = 0; k < n; k++) {
+         gen->coef[k] = (elem_t)num[k];
+      }
+      break;
+
+      case GEN_PHILOX:
+      if (n > 1) {
+         return(-1);
+      }
+      gen->key[0] = (n > 0) ? (uint32_t)num[0] : 0;
+      gen->key[1] = (n > 0) ? (uint32_t)((unsigned long long)num[0] >> 32) : 0;
+#ifdef GEN_X86
+      gen->vector = __builtin_cpu_supports("avx2");
+#endif
+      break;
+   } // End switch
+   return(0);
+} // End genParse
+
+
+/****************************************************************************
+  Compute one element, the reference for all the fill paths
+
+  elem_t genValue(const struct Gen_s *gen, long i)
+  Where: const struct Gen_s *gen - the generator
+         long i                  - element index
+  Returns: elem_t - element i
+  Errors: none
+****************************************************************************/
+elem_t genValue(const struct Gen_s *gen, long i) {
+   if (gen->type == GEN_PHILOX) {
+      uint32_t w[4];
+      long r = i%BLOCK_ELEMS;
+
+      philox(gen->key, (uint64_t)(i/BLOCK_ELEMS)*PHILOX_LANES + r%PHILOX_LANES, w);
+      return(philoxElem(w, r));
+   }
+
+   // Horner's rule, unsigned so it wraps
+   uelem_t v = (uelem_t)gen->coef[gen->degree];
+   for (int k = gen->degree - 1; k >= 0; k--) {
+      v = v*(uelem_t)i + (uelem_t)gen->coef[k];
+   }
+   return((elem_t)v);
+} // End genValue
+
+
+/****************************************************************************
+  Fill a range of elements
+
+  void genFill(const struct Gen_s *gen, elem_t *dst, long first, long count)
+  Where: const struct Gen_s *gen - the generator
+         elem_t *dst             - where element first goes
+         long first              - index of the first element
+         long count              - number of elements
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void genFill(const struct Gen_s *gen, elem_t *dst, long first, long count) {
+   long k = 0;
+
+   switch (gen->type) {
+      case GEN_AFFINE: {
+      elem_t start = genValue(gen, first);
+      for (k = 0; k < count; k++) {
+         dst[k] = AP_VALUE(start, gen->coef[1], k);
+      }
+      break;
+      }
+
+      case GEN_POLY: {
+      // Forward differences at first: diff[j] is the j-th difference, the
+      // degree-th one is constant so each step is degree additions
+      uelem_t diff[GEN_MAX_DEGREE + 1];
+      int d = gen->degree;
+
+      for (int j = 0; j <= d; j++) {
+         diff[j] = (uelem_t)genValue(gen, first + j);
+      }
+      for (int j = 1; j <= d; j++) {
+         for (int m = d; m >= j; m--) {
+            diff[m] -= diff[m - 1];
+         }
+      }
+      for (k = 0; k < count; k++) {
+         dst[k] = (elem_t)diff[0];
+         for (int j = 0; j < d; j++) {
+            diff[j] += diff[j + 1];
+         }
+      }
+      break;
+      }
+
+      case GEN_PHILOX: {
+      long numBlocks;
+
+      // Single elements up to a block boundary, whole blocks, then the tail
+      for (; k < count && (first + k)%BLOCK_ELEMS != 0; k++) {
+         dst[k] = genValue(gen, first + k);
+      }
+      numBlocks = (count - k)/BLOCK_ELEMS;
+#ifdef GEN_X86
+      if (gen->vector) {
+         philoxBlocksAvx2(gen->key, (first + k)/BLOCK_ELEMS, numBlocks, &dst[k]);
+         k += numBlocks*BLOCK_ELEMS;
+      }
+#endif
+      for (; k + BLOCK_ELEMS <= count; k += BLOCK_ELEMS) {
+         philoxBlock(gen->key, (first + k)/BLOCK_ELEMS, &dst[k]);
+      }
+      for (; k < count; k++) {
+         dst[k] = genValue(gen, first + k);
+      }
+      break;
+      }
+   } // End switch
+} // End genFill
+
+
+/****************************************************************************
+  Check a range of elements against the generator, a piece at a time
+  generated into a local buffer
+
+  long genVerify(const struct Gen_s *gen, const elem_t *src, long first,
+                 long count)
+  Where: const struct Gen_s *gen - the generator
+         const elem_t *src       - where element first is
+         long first              - index of the first element
+         long count              - number of elements
+  Returns: long - offset of the first mismatch from src, count if none
+  Errors: none
+****************************************************************************/
+long genVerify(const struct Gen_s *gen, const elem_t *src, long first, long count) {
+   elem_t expect[VERIFY_ELEMS];
+
+   for (long k = 0; k < count; k += VERIFY_ELEMS) {
+      long n = (count - k < VERIFY_ELEMS) ? count - k : VERIFY_ELEMS;
+
+      genFill(gen, expect, first + k, n);
+      if (memcmp(expect, &src[k], n*sizeof(elem_t)) == 0) {
+         continue;
+      }
+      for (long j = 0; j < n; j++) {
+         if (expect[j] != src[k + j]) {
+            return(k + j);
+         }
+      }
+   }
+   return(count);
+} // End genVerify
+
+
+/****************************************************************************
+  Name of the generator type
+
+  const char *genName(const struct Gen_s *gen)
+  Where: const struct Gen_s *gen - the generator
+  Returns: const char * - affine, poly or philox
+  Errors: none
+****************************************************************************/
+const char *genName(const struct Gen_s *gen) {
+   if (gen->type < 0 || gen->type >= NUM_GENS) {
+      return("unknown");
+   }
+   return(genNames[gen->type]);
+} // End genName
@@ -0,0 +1,50 @@
+/******************************************************************************
+* Generator kernels for hw13
+*
+* Every generator computes element i from i alone, so any worker can fill
+* or check any range without shared state:
+*   affine - a*i + b, filled by the progression kernels of fill.h
+*   poly   - c0 + c1*i + ... + cd*i^d, walked with d additions per element
+*            from a table of forward differences set up at each range start
+*   philox - Philox4x32-10 counter based random numbers keyed by a 64 bit
+*            seed.  One counter gives four 32 bit words, the words of eight
+*            counters make one block of elements laid out word by word so
+*            eight counters are computed side by side in AVX2 registers.
+* All arithmetic wraps in the element type.
+*
+* Specs: affine[:a[,b]]  poly:c0[,c1...]  philox[:seed]
+******************************************************************************/
+#ifndef _GEN_H_
+#define _GEN_H_
+
+#include <stdint.h>
+#include "fill.h"
+
+/* Generator types */
+#define GEN_AFFINE          (0)
+#define GEN_POLY            (1)
+#define GEN_PHILOX          (2)
+
+/* Step of a plain "affine" spec, the original 3*i sequence */
+#define GEN_AFFINE_STEP     (3)
+
+/* Highest polynomial power */
+#define GEN_MAX_DEGREE      (7)
+
+/* A parsed generator, read only once the fill starts */
+struct Gen_s {
+   int type;                        // One of the GEN_xxx values
+   int degree;                      // Highest power, 1 for affine
+   elem_t coef[GEN_MAX_DEGREE + 1]; // coef[k] multiplies i^k
+   uint32_t key[2];                 // Philox key, the seed
+   int vector;                      // Use the AVX2 Philox kernel
+};
+
+/* Function prototypes */
+int genParse(struct Gen_s *gen, const char *spec);
+elem_t genValue(const struct Gen_s *gen, long i);
+void genFill(const struct Gen_s *gen, elem_t *dst, long first, long count);
+long genVerify(const struct Gen_s *gen, const elem_t *src, long first, long count);
+const char *genName(const struct Gen_s *gen);
+
+#endif /* _GEN_H_ */
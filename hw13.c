@@ -1,84 +1,188 @@
-//  This fills ram with +3 sequential integers
+//  This fills ram with +3 sequential integers, or the values of another
+//  generator (see gen.h)
 //  student file
 //
-//   gcc -g -O0 -std=c99 hw13.c -lpthread -o hw13 -Wall -pedantic
+//   gcc -g -O0 -std=c99 hw13.c export.c stats.c perf.c scan.c stream.c pipe.c engine.c pool.c fill.c gen.c work.c mem.c place.c digest.c -lpthread -o hw13 -Wall -pedantic
 //  valgrind --tool=memcheck --leak-check=yes ./hw13 -f -s
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <limits.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #define EN_TIME
 #include "Timers.h"
 #include "ClassErrors.h"
+#include "pool.h"
+#include "fill.h"
+#include "place.h"
+#include "mem.h"
+#include "export.h"
+#include "stats.h"
+#include "perf.h"
+#include "gen.h"
+#include "scan.h"
+#include "stream.h"
+#include "work.h"
+#include "engine.h"
+#include "pipe.h"
+#include "digest.h"
 
 /*--------------------------------------------------------------------------
   Local data structures and defines 
 --------------------------------------------------------------------------*/
 // Use the larger data size of the Linux cluster, smaller for
 // a typical PC. 
-// guarantees divisible by 2/3/4/5/7/8  Note: this number is VERY large
-// and MAY cause overflow issues
-#define DATA_SIZE           (136*3*5*7*146*512)
-#define VALGRIND_DATA_SIZE  (30*3*5*7*8*1024)
+// guarantees divisible by 2/3/4/5/7/8  Note: this number is VERY large,
+// indexes are 64 bit and the values wrap in the element type (see fill.h)
+#define DATA_SIZE           (136L*3*5*7*146*512)
+#define VALGRIND_DATA_SIZE  (30L*3*5*7*8*1024)
 
 
-// Maximum number of threads 
-#define MAX_THREADS     (8)
-
-// The number of iterations to slow down thread execution
-#define DELAY_LOOPS_EXP        (5)     
+// The thread count is limited to the CPUs this process may use, but never
+// below the old fixed limit so small machines can still be oversubscribed
+#define MIN_THREAD_CAP  (8)
 
 // The percentage rate to update thread progress
 #define STATUS_UPDATE_RATE (10)
 
-// Thread information control structure 
+// Default milliseconds between two status lines
+#define STATUS_INTERVAL_MS (1000)
+
+// Store modes of the fill, "both" also times the two against each other
+#define STORES_NORMAL   (0)
+#define STORES_STREAM   (1)
+#define STORES_BOTH     (2)
+
+// Verification of the fill, element by element or by segment digests
+#define CHECK_ELEMENTS  (0)
+#define CHECK_DIGEST    (1)
+
+// Elements the digest reference is regenerated in at a time
+#define DIGEST_WINDOW   (4096)
+
+// Thread information control structure, one per cache line so that the
+// workers never share a line
   struct ThreadData_s {
      int threadID;      // Contains the thread ID number 0..n
-     int segSize;       // The amount of total work for this thread
-                        // threadID*segSize is the starting index of
-                        // the data to initialize
-     int *dataPtr;      // Pointer to the one contagious array buffer
-                        // that each thread will work on
+     long segStart;     // First index of this thread's segment
+     long segSize;      // The amount of total work for this thread, the
+                        // remainder of dataSize/numThreads is spread one
+                        // element each over the first segments
+     elem_t *dataPtr;   // Pointer to the one contagious array buffer
+                        // that all the threads work on
+     struct Sched_s *sched; // Hands out the chunks of the array to fill
+     long touchStep;    // Elements between two touches in the prefault pass
+     int kernel;        // Fill kernel, KERNEL_SCALAR runs the reference loop
+     FillFn_t fill;     // The vector fill routine for the other kernels
+     VerifyFn_t verify; // The verifier matching the fill kernel
+     const struct Gen_s *gen; // Generator of the element values
+     long workIters;    // Synthetic work iterations per element, see work.h
+     double workSink;   // Result of the work, kept so it is not optimized away
+     uelem_t segSum;    // Sum of the segment from the reduction pass, or
+                        // of everything the worker checked in window mode
+     long window;       // Elements of the private window, 0 if not windowed
+     uelem_t segOffset; // Sum of all the earlier segments for the scan pass
+     struct Digest_s digest;    // Digest of the segment as it is in memory
+     struct Digest_s refDigest; // Digest the generator gives for the segment
+     struct Export_s *exporter; // Streams finished chunks out, NULL if not
+     struct Buffer_s *syncBuf;  // File buffer to write back, NULL if not
+     struct ThreadStats_s *stats; // Run statistics of this worker
+     int perf;          // Flag to count hardware events around the fill
+     struct Perf_s counters; // The counts of the last fill
+     int cpu;           // CPU the worker is pinned to, -1 if not pinned
+     int node;          // NUMA node of that CPU
      int trackStatus;   // Flag to identify if status updates should be reported
      int verbose;       // Flag to indicate if the task should run in verbose mode
+  } __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Per-thread progress slot, written only by its own worker with relaxed
+// atomics and summed by the status reporter, no lock needed
+  struct Progress_s {
+     long processed;    // Number of elements this worker has filled
+  } __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Status reporter state.  The reporter sleeps on the condition until its
+// next tick, a worker crossing a milestone or the end of the fill.
+  struct Reporter_s {
+     pthread_mutex_t lock;
+     pthread_cond_t cond;    // Waited on with the monotonic clock
+     int milestone;          // Set by a worker that crossed a milestone
+     int done;               // Set by main once all workers are joined
+     long intervalMs;        // Time between two ticks
+     long total;             // Elements in the fill
+     int numThreads;
   };
 
+// Per-thread return code, padded like the progress slots
+  struct RcCode_s {
+     int rc;
+  } __attribute__((aligned(CACHE_LINE_SIZE)));
+
   
 /* Function prototypes */
 void *do_process(void *data);
+void chunk_done(struct ThreadData_s *data, long begin, long end, double seconds);
+void *do_verify(void *data);
+void *do_touch(void *data);
+void *do_store(void *data);
+void *do_window(void *data);
+void *do_reduce(void *data);
+void *do_digest(void *data);
+void *do_scan(void *data);
+void *do_scan_check(void *data);
+void record_error(long bad);
+uelem_t affine_sum(const struct Gen_s *gen, long n);
+void run_job(struct Pool_s *pool, struct ThreadData_s *threadData,
+             int numThreads, int policy, long count, long chunk,
+             void *(*fn)(void *));
+int online_cpus(void);
+void *alloc_lines(size_t size);
+long total_processed(int numThreads);
+void publish_progress(struct ThreadData_s *data, long done, long *mark, long lim);
+void *do_report(void *data);
+int print_counters(int thread, const struct Perf_s *perf, long elements);
+
+/* Progress counters and return codes, one cache line per thread */
+   struct Progress_s *progress;
+   struct RcCode_s *rc_codes; //return codes array of size of num threads
+   struct ThreadStats_s *thread_stats; //chunk times and rates of each worker
+   struct Reporter_s reporter;
 
-/* Used to control access to the progress counter */
-   volatile int processed = 0;
-   pthread_mutex_t lock;
-   int rc_codes[MAX_THREADS]; //return codes array of size of num threads
+/* Lowest mismatching index found by the verify workers, dataSize if none */
+   long first_error __attribute__((aligned(CACHE_LINE_SIZE)));
 
 
 int main(int argc, char *argv[]) {
    /*------------------------------------------------------------------------
      General purpose variables 
    ------------------------------------------------------------------------*/
-  // DECLARE_TIMER(timer); 
- 
-   time_t  wallTime = time(NULL);;    // Used to report wall execution time.
+   // Wall clock timers, clock() would add up the CPU time of all threads
+   DECLARE_WTIMER(totalTimer)
+   DECLARE_WTIMER(fillTimer)
+   START_NTIMER(totalTimer);
    
-   int* int_array;
-
-   if (pthread_mutex_init(&lock, NULL)) {
-	printf("mutex initialization failed in main\n");
-	exit(99);
-   }
+   elem_t* int_array;
+   struct Buffer_s buffer;
+   struct Export_s *exporter = NULL;
   
- //  pthread_mutex_t mut_thread;
    /*------------------------------------------------------------------------
      Thread process information
    ------------------------------------------------------------------------*/
    void *rcp; //process return code
-   pthread_t th_array[MAX_THREADS];
-   struct ThreadData_s threadData[MAX_THREADS];
+   struct Pool_s *pool;
+   struct Sched_s sched;
+   struct ThreadData_s *threadData;
+   int *cpus;              // Placement of each worker
+   int *nodes;
    
    /*------------------------------------------------------------------------
       UI variables with sentential values
@@ -86,23 +190,78 @@ int main(int argc, char *argv[]) {
    int rc;
 //   int opterr;
    int verbose = 0; 
-   int status;
-   int dataSize = DATA_SIZE;
+   int status = 0;
+   long dataSize = DATA_SIZE;
    int numThreads = 0;
+   int onlineCpus = online_cpus();
+   int maxThreads = (onlineCpus > MIN_THREAD_CAP) ? onlineCpus : MIN_THREAD_CAP;
+   int policy = POLICY_DYNAMIC;
+   int policySet = 0;      // Flag for an explicit -p
+   long chunk = DEFAULT_CHUNK;
+   int kernel = KERNEL_AUTO;
+   char *affinity = "none";
+   int memMode = MEM_MALLOC;
+   int prefault = 0;
+   char *outPath = NULL;
+   char *memPath = NULL;   // Backing file of the file memory mode
+   char *statsPath = NULL;
+   int perf = 0;
+   long intervalMs = STATUS_INTERVAL_MS;
+   struct Gen_s gen;       // Element i holds genValue(&gen, i)
+   char *genSpec = "affine";
+   int scan = 0;
+   int stores = STORES_NORMAL;
+   int check = CHECK_ELEMENTS;
+   long streamSize = 0;    // Elements per STREAM array, 0 for no STREAM run
+   long submits = 0;       // Requests of the engine refill, 0 for none
+   int pipeConsumers = 0;  // Consumer threads of the pipeline, 0 for no pipeline
+   int pipeSlots = 0;      // Chunk buffers of the pipeline, 0 for the default
+   long window = 0;        // Elements per worker window, 0 for the whole array
+#ifdef HW13_TEST
+   long inject = -1;       // Element corrupted before the check, -1 for none
+#endif
+   char *workSpec = NULL;  // Work per element, default only for scalar
+   long workPerElem = 0;   // Work iterations per element
+   pthread_t reporterThread;
   
    int option_index = 0;
-   char *getoptOptions = "t:sfv";   
+   char *getoptOptions = "t:sfvp:c:k:a:m:n:o:S:i:g:w:W:";   
 
    /*------------------------------------------------------------------------
      These variables are used to control the getopt_long_only command line 
      parsing utility.  
    ------------------------------------------------------------------------*/
    struct option long_options[] = {
-	{"threads", required_argument, 0, 'o'}, //num threads, required
+	{"threads", required_argument, 0, 't'}, //num threads, required
 	{"status", no_argument, 0, 's'},	//display thread progress, optional
+	{"interval", required_argument, 0, 'i'}, //status interval in ms, optional
 	{"fast", no_argument, 0, 'f'},		//shorter data run for Valgrind, optional
+	{"numbers", required_argument, 0, 'n'}, //data size, optional
 	{"verbose", no_argument, 0, 'v'},
 	{"verb", no_argument, 0, 'v'},
+	{"policy", required_argument, 0, 'p'}, //chunk scheduling policy, optional
+	{"chunk", required_argument, 0, 'c'},  //elements per chunk, optional
+	{"kernel", required_argument, 0, 'k'}, //force a fill kernel, optional
+	{"gen", required_argument, 0, 'g'},    //element generator, optional
+	{"work", required_argument, 0, 'w'},   //synthetic work per element, optional
+	{"affinity", required_argument, 0, 'a'}, //worker placement, optional
+	{"mem", required_argument, 0, 'm'},    //buffer allocation mode, optional
+	{"prefault", no_argument, 0, 'r'},     //timed prefault pass, optional
+	{"scan", no_argument, 0, 'x'},         //reduction and prefix sum, optional
+	{"stream", required_argument, 0, 'b'}, //STREAM bandwidth run, optional
+	{"submit", required_argument, 0, 'u'}, //refill through the engine, optional
+	{"pipe", required_argument, 0, 'q'},   //pipelined fill and check, optional
+	{"stores", required_argument, 0, 'j'}, //normal or streaming stores, optional
+	{"ring", required_argument, 0, 'y'},   //pipeline chunk buffers, optional
+	{"Window", required_argument, 0, 'W'}, //constant memory windows, optional
+	{"window", required_argument, 0, 'W'},
+	{"check", required_argument, 0, 'l'},  //verification method, optional
+#ifdef HW13_TEST
+	{"inject", required_argument, 0, 'z'}, //corrupt an element, test builds
+#endif
+	{"out", required_argument, 0, 'o'},    //stream the data to a file, optional
+	{"Stats", required_argument, 0, 'S'},  //run statistics file, optional
+	{"perf", no_argument, 0, 'e'},         //hardware counters, optional
 	{0, 0, 0, 0}
    };
  
@@ -112,9 +271,14 @@ int main(int argc, char *argv[]) {
 	switch(rc)
 	{ 
 	  case 't':
-	  numThreads = atoi(optarg);
-	  if (numThreads > 8 || numThreads < 1) {
-		printf("Number of threads should be greater than 0 and less than 9\n");
+	  if (strcmp(optarg, "auto") == 0) {
+		numThreads = onlineCpus;
+	  }
+	  else {
+		numThreads = atoi(optarg);
+	  }
+	  if (numThreads > maxThreads || numThreads < 1) {
+		printf("Number of threads should be auto or 1 to %d\n", maxThreads);
 		exit(-99); }
 	  break;
 
@@ -122,14 +286,178 @@ int main(int argc, char *argv[]) {
 	  status = 1;
 	  break;
 
+	  case 'i':
+	  intervalMs = atol(optarg);
+	  if (intervalMs < 1) {
+		printf("Status interval should be at least 1 ms\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
 	  case 'f':
 	  dataSize = VALGRIND_DATA_SIZE;
 	  break;
 
+	  case 'n':
+	  // Accept 4e9 style sizes, the array may hold more than 2^31 elements
+	  dataSize = (long)strtod(optarg, NULL);
+	  if (dataSize < 1) {
+		printf("Number of elements should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
 	  case 'v':
 	  verbose = 1;
 	  break;
 
+	  case 'p':
+	  policy = schedPolicy(optarg);
+	  if (policy < 0) {
+		printf("Policy should be static, dynamic, guided or steal\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  policySet = 1;
+	  break;
+
+	  case 'c':
+	  chunk = atol(optarg);
+	  if (chunk < 1) {
+		printf("Chunk size should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'k':
+	  kernel = fillKernel(optarg);
+	  if (kernel == -2) {
+		printf("Kernel should be auto, scalar, sse2, avx2 or avx512\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  if (kernel != KERNEL_AUTO && !fillSupported(kernel)) {
+		printf("The %s kernel is not supported by this CPU\n", optarg);
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'g':
+	  genSpec = optarg;
+	  if (genParse(&gen, genSpec)) {
+		printf("Generator should be affine[:a[,b]], poly:c0[,c1...] or philox[:seed]\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'w':
+	  workSpec = optarg;
+	  if (workIters(workSpec, 1.0) < 0) {
+		printf("Work should be ns per element like 25 or 25ns, or FLOPs like 100f\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'a':
+	  affinity = optarg;
+	  if (placeAffinity(affinity) < 0) {
+		printf("Affinity should be none, compact, scatter or a cpu list like 0-3,8\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'm':
+	  if (strncmp(optarg, "file:", 5) == 0 && optarg[5] != '\0') {
+		memMode = MEM_FILE;
+		memPath = optarg + 5;
+		break;
+	  }
+	  memMode = bufMode(optarg);
+	  if (memMode < 0 || memMode == MEM_FILE) {
+		printf("Memory mode should be malloc, mmap, thp, huge or file:path\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'r':
+	  prefault = 1;
+	  break;
+
+	  case 'x':
+	  scan = 1;
+	  break;
+
+	  case 'b':
+	  streamSize = (long)strtod(optarg, NULL);
+	  if (streamSize < 1) {
+		printf("STREAM array size should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'u':
+	  submits = (long)strtod(optarg, NULL);
+	  if (submits < 1) {
+		printf("Number of requests should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'q':
+	  pipeConsumers = atoi(optarg);
+	  if (pipeConsumers < 1 || pipeConsumers > maxThreads) {
+		printf("Number of consumer threads should be 1 to %d\n", maxThreads);
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'j':
+	  if (strcmp(optarg, "normal") == 0) {
+		stores = STORES_NORMAL;
+	  }
+	  else if (strcmp(optarg, "stream") == 0) {
+		stores = STORES_STREAM;
+	  }
+	  else if (strcmp(optarg, "both") == 0) {
+		stores = STORES_BOTH;
+	  }
+	  else {
+		printf("Stores should be normal, stream or both\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'l':
+	  if (strcmp(optarg, "elements") == 0) {
+		check = CHECK_ELEMENTS;
+	  }
+	  else if (strcmp(optarg, "digest") == 0) {
+		check = CHECK_DIGEST;
+	  }
+	  else {
+		printf("Check should be elements or digest\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+#ifdef HW13_TEST
+	  case 'z':
+	  inject = (long)strtod(optarg, NULL);
+	  if (inject < 0) {
+		printf("Injected element should be 0 or more\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+#endif
+
+	  case 'W':
+	  window = (long)strtod(optarg, NULL);
+	  if (window < 1) {
+		printf("Window size should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'y':
+	  pipeSlots = atoi(optarg);
+	  if (pipeSlots < 1) {
+		printf("Number of ring slots should be greater than 0\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'o':
+	  outPath = optarg;
+	  break;
+
+	  case 'S':
+	  statsPath = optarg;
+	  break;
+
+	  case 'e':
+	  perf = 1;
+	  break;
+
 	  case '?':
 	  break;
  
@@ -144,86 +472,787 @@ int main(int argc, char *argv[]) {
    ------------------------------------------------------------------------*/
    if ((optind < argc) || numThreads == 0 ){
       fprintf(stderr, "This program demonstrates threading performance.\n");
-      fprintf(stderr, "usage: hw13 -t[hreads] num [-s[tatus]] [-f[ast]] [-v[erbose]] \n");
-      fprintf(stderr, "Where: -t[hreads] num - number of threads 1 to %d,required\n", MAX_THREADS);
+      fprintf(stderr, "usage: hw13 -t[hreads] num [-s[tatus]] [-i[nterval] ms] [-f[ast]] [-n[umbers] num] [-v[erbose]]\n");
+      fprintf(stderr, "            [-p[olicy] name] [-c[hunk] num] [-k[ernel] name] [-g[en] spec]\n");
+      fprintf(stderr, "            [-w[ork] spec]\n");
+      fprintf(stderr, "            [-a[ffinity] spec] [-m[em] mode] [-prefault]\n");
+      fprintf(stderr, "            [-o[ut] path] [-S[tats] file] [-perf] [-scan]\n");
+      fprintf(stderr, "            [-stores mode] [-stream num] [-submit num]\n");
+      fprintf(stderr, "            [-pipe num] [-ring num] [-W[indow] num] [-check mode]\n");
+#ifdef HW13_TEST
+      fprintf(stderr, "            [-inject index]\n");
+#endif
+      fprintf(stderr, "Where: -t[hreads] num - number of threads 1 to %d or auto for\n", maxThreads);
+      fprintf(stderr, "                        one per CPU (%d), required\n", onlineCpus);
       fprintf(stderr, "       -s[tatus]      - display thread progress, optional\n"); 
+      fprintf(stderr, "       -i[nterval] ms - time between status lines, more often\n");
+      fprintf(stderr, "                        when the workers pass %d%% steps,\n", STATUS_UPDATE_RATE);
+      fprintf(stderr, "                        optional, default %d\n", STATUS_INTERVAL_MS);
       fprintf(stderr, "       -v[erbose]     - verbose flag, optional\n");
       fprintf(stderr, "       -f[ast]        - shorter run for Valgrind, optional\n");
+      fprintf(stderr, "       -n[umbers] num - number of elements, 4e9 style accepted,\n");
+      fprintf(stderr, "                        optional, default %ld\n", DATA_SIZE);
+      fprintf(stderr, "       -p[olicy] name - static, dynamic, guided or steal chunk\n");
+      fprintf(stderr, "                        scheduling, optional, default dynamic\n");
+      fprintf(stderr, "       -c[hunk] num   - elements per chunk, optional, default %d\n", DEFAULT_CHUNK);
+      fprintf(stderr, "       -k[ernel] name - auto, scalar, sse2, avx2 or avx512 fill,\n");
+      fprintf(stderr, "                        optional, default auto picks the widest\n");
+      fprintf(stderr, "                        the CPU supports, scalar is the slowed\n");
+      fprintf(stderr, "                        down reference loop\n");
+      fprintf(stderr, "       -w[ork] spec   - calibrated synthetic work per element, ns\n");
+      fprintf(stderr, "                        like 25 or 25ns, or FLOPs like 100f,\n");
+      fprintf(stderr, "                        optional, default %.0fns for the scalar\n", WORK_DEFAULT_NS);
+      fprintf(stderr, "                        kernel and none for the others\n");
+      fprintf(stderr, "       -g[en] spec    - element values: affine[:a[,b]] for a*i+b,\n");
+      fprintf(stderr, "                        poly:c0[,c1...] for c0+c1*i+..., up to\n");
+      fprintf(stderr, "                        i^%d, or philox[:seed] random numbers,\n", GEN_MAX_DEGREE);
+      fprintf(stderr, "                        optional, default affine (%d*i)\n", GEN_AFFINE_STEP);
+      fprintf(stderr, "       -a[ffinity] spec - none, compact, scatter or a cpu list\n");
+      fprintf(stderr, "                        like 0-3,8 to pin the workers, their\n");
+      fprintf(stderr, "                        memory is first touched by the owner\n");
+      fprintf(stderr, "                        and is only node-local with the static\n");
+      fprintf(stderr, "                        policy, the default with -a, optional,\n");
+      fprintf(stderr, "                        default none\n");
+      fprintf(stderr, "       -m[em] mode    - malloc, mmap, thp or huge (MAP_HUGETLB)\n");
+      fprintf(stderr, "                        buffer, falls back to normal pages,\n");
+      fprintf(stderr, "                        or file:path to fill a shared mapping\n");
+      fprintf(stderr, "                        of that file, may exceed RAM and is\n");
+      fprintf(stderr, "                        kept after the run, optional, default\n");
+      fprintf(stderr, "                        malloc\n");
+      fprintf(stderr, "       -prefault      - fault the pages in a separately timed\n");
+      fprintf(stderr, "                        parallel pass before the fill, optional\n");
+      fprintf(stderr, "       -o[ut] path    - stream the raw elements to a file or pipe\n");
+      fprintf(stderr, "                        while the fill runs, optional\n");
+      fprintf(stderr, "       -S[tats] file  - write per-thread rates and chunk time\n");
+      fprintf(stderr, "                        percentiles as JSON, or CSV if the name\n");
+      fprintf(stderr, "                        ends in .csv, optional\n");
+      fprintf(stderr, "       -perf          - count cycles, instructions, LLC and dTLB\n");
+      fprintf(stderr, "                        misses and page faults per worker, the\n");
+      fprintf(stderr, "                        ones the system refuses are left out,\n");
+      fprintf(stderr, "                        optional\n");
+      fprintf(stderr, "       -scan          - after the verification sum the array and\n");
+      fprintf(stderr, "                        replace it with its running totals in\n");
+      fprintf(stderr, "                        parallel, both checked, optional\n");
+      fprintf(stderr, "       -stores mode   - normal, stream for non-temporal stores\n");
+      fprintf(stderr, "                        that bypass the cache, or both to fill\n");
+      fprintf(stderr, "                        normally and then time a pass of each,\n");
+      fprintf(stderr, "                        vector kernels and affine generator,\n");
+      fprintf(stderr, "                        optional, default normal\n");
+      fprintf(stderr, "       -stream num    - measure STREAM copy, scale, add and triad\n");
+      fprintf(stderr, "                        GB/s on three arrays of num doubles with\n");
+      fprintf(stderr, "                        1, 2, 4... up to all the threads, optional\n");
+      fprintf(stderr, "       -submit num    - clear the array and fill it again as num\n");
+      fprintf(stderr, "                        back to back requests to the fill engine\n");
+      fprintf(stderr, "                        (engine.h), then verify it, optional\n");
+      fprintf(stderr, "       -pipe num      - no array: the threads fill chunk buffers\n");
+      fprintf(stderr, "                        that num consumer threads verify, sum\n");
+      fprintf(stderr, "                        and write to -o (regular files only)\n");
+      fprintf(stderr, "                        as they arrive, optional\n");
+      fprintf(stderr, "       -ring num      - chunk buffers of -pipe, the memory used,\n");
+      fprintf(stderr, "                        optional, default %d per thread\n", PIPE_SLOTS_PER_THREAD);
+      fprintf(stderr, "       -W[indow] num  - no array: each thread fills and checks\n");
+      fprintf(stderr, "                        its part of the numbers num elements at\n");
+      fprintf(stderr, "                        a time in a private window, memory stays\n");
+      fprintf(stderr, "                        threads x num, e.g. 32768 (%d KB) fits\n", (int)(32768*sizeof(elem_t)/1024));
+      fprintf(stderr, "                        most L2 caches, optional\n");
+      fprintf(stderr, "       -check mode    - elements to compare every element with\n");
+      fprintf(stderr, "                        the generator, or digest to compare a\n");
+      fprintf(stderr, "                        sum, sum of squares and CRC32C of each\n");
+      fprintf(stderr, "                        segment with the generator's, the\n");
+      fprintf(stderr, "                        affine sums in closed form without\n");
+      fprintf(stderr, "                        the CRC, optional, default elements\n");
+#ifdef HW13_TEST
+      fprintf(stderr, "       -inject index  - flip a bit of that element after the\n");
+      fprintf(stderr, "                        fill so the check must fail, test\n");
+      fprintf(stderr, "                        builds only, optional\n");
+#endif
       fprintf(stderr, "eg: hw13 -t 3 -status\n");
       fflush(stderr);
       return(PGM_SYNTAX_ERROR);
    } /* End if error */
+   if (pipeConsumers > 0 && window > 0) {
+	printf("The pipeline and window modes can not be combined\n");
+	exit(PGM_SYNTAX_ERROR);
+   }
+#ifdef HW13_TEST
+   if (inject >= dataSize || (inject >= 0 && (pipeConsumers > 0 || window > 0))) {
+	printf("The injected element must be in the array, not with -pipe or -W\n");
+	exit(PGM_SYNTAX_ERROR);
+   }
+#endif
+   // The pipeline keeps no array and runs its consumers on a pool of its
+   // own, so there is nothing to place, map, prefault, track, scan, stream,
+   // submit, digest or count, and its fills use the plain stores
+   if (pipeConsumers > 0 && (placeAffinity(affinity) != AFFINITY_NONE ||
+       memMode != MEM_MALLOC || prefault || status || statsPath != NULL ||
+       scan || streamSize > 0 || submits > 0 || check == CHECK_DIGEST ||
+       perf || stores != STORES_NORMAL)) {
+	printf("The pipeline mode can not be combined with -a, -m, -prefault, -s, -S,\n"
+	       "-scan, -stream, -submit, -check digest, -perf or -stores\n");
+	exit(PGM_SYNTAX_ERROR);
+   }
+   // Nor do the windows, whose elements are gone before they could be
+   // exported, scanned, streamed, submitted or digested, and they finish
+   // without the status, statistics and counter passes.  A window stays in
+   // cache, so it is filled with the plain stores
+   if (window > 0 && (memMode != MEM_MALLOC || prefault || outPath != NULL ||
+       status || statsPath != NULL || scan || streamSize > 0 || submits > 0 ||
+       check == CHECK_DIGEST || perf || stores != STORES_NORMAL)) {
+	printf("The window mode can not be combined with -m, -prefault, -o, -s, -S,\n"
+	       "-scan, -stream, -submit, -check digest, -perf or -stores\n");
+	exit(PGM_SYNTAX_ERROR);
+   }
+   // Pinned workers only get node-local pages if each one fills the segment
+   // it first touched, which the other policies do not keep to
+   if (placeAffinity(affinity) != AFFINITY_NONE) {
+	if (!policySet) {
+	   policy = POLICY_STATIC;
+	}
+	else if (policy != POLICY_STATIC) {
+	   printf("The %s policy fills chunks on any worker, pages are not node-local\n",
+	          schedName(policy));
+	}
+   }
 
-   /* Get space for the data */
-   int_array = (int*)malloc(dataSize*sizeof(int));
-   if(int_array == NULL) {
-	printf("int array malloc failed\n");
+   /* Get space for the data, the pipeline and the windows have their own */
+   if (pipeConsumers > 0 || window > 0) {
+	memset(&buffer, 0, sizeof(buffer));
+   }
+   else if (memMode == MEM_FILE) {
+	if (bufMapFile(&buffer, dataSize*sizeof(elem_t), memPath)) {
+	   printf("Can not map %s: %s\n", memPath, strerror(errno));
+	   exit(PGM_FILE_NOT_FOUND);
+	}
+   }
+   else if (bufAlloc(&buffer, dataSize*sizeof(elem_t), memMode)) {
+	printf("int array %s allocation failed\n", bufName(memMode));
 	exit(-99); 
 	}
+   int_array = (elem_t*)buffer.ptr;
+   if (buffer.mode != memMode) {
+	printf("%s pages not available, using %s\n", bufName(memMode), bufName(buffer.mode));
+   }
+   if (verbose) {
+	printf("Buffer: %s, %ldKB pages\n", bufName(buffer.mode), (long)buffer.pageSize/1024);
+   }
    
    
+   /* Per-thread information, one cache line apart */
+   threadData = alloc_lines(numThreads*sizeof(struct ThreadData_s));
+   progress = alloc_lines(numThreads*sizeof(struct Progress_s));
+   rc_codes = alloc_lines(numThreads*sizeof(struct RcCode_s));
+   thread_stats = alloc_lines(numThreads*sizeof(struct ThreadStats_s));
+   cpus = malloc(numThreads*sizeof(int));
+   nodes = malloc(numThreads*sizeof(int));
+   if (cpus == NULL || nodes == NULL) {
+	printf("thread information malloc failed\n");
+	exit(MALLOC_ERROR);
+   }
+
+   // The worker threads persist until the end of the run
+   pool = poolCreate(numThreads);
+   if (pool == NULL) {
+	fprintf(stderr, "Failed to create the worker pool\n");
+	exit(99);
+   }
+   if (schedInit(&sched, policy, dataSize, chunk, numThreads)) {
+	fprintf(stderr, "Failed to initialize the %s scheduler\n", schedName(policy));
+	exit(99);
+   }
+
+   // Pick the fill kernel once for all the threads
+   if (kernel == KERNEL_AUTO) {
+	kernel = fillBest();
+   }
+   genParse(&gen, genSpec);
+
+   // Size the synthetic work with the cost measured on this host
+   if (workSpec != NULL || kernel == KERNEL_SCALAR) {
+	double nsPerIter = workCalibrate();
+	if (workSpec != NULL) {
+	   workPerElem = workIters(workSpec, nsPerIter);
+	}
+	else {
+	   workPerElem = (long)(WORK_DEFAULT_NS/nsPerIter + 0.5);
+	}
+	if (verbose) {
+	   printf("Work: %ld iterations (%ld FLOPs, %.1f ns) per element\n",
+	          workPerElem, 2*workPerElem, workPerElem*nsPerIter);
+	}
+   }
+   gen.vector = gen.vector && kernel >= KERNEL_AVX2;
+   if (stores != STORES_NORMAL && (kernel == KERNEL_SCALAR || gen.type != GEN_AFFINE)) {
+	printf("Streaming stores need a vector kernel and the affine generator\n");
+	exit(PGM_SYNTAX_ERROR);
+   }
+   if (verbose) {
+	printf("Fill kernel: %s  generator: %s\n", fillName(kernel), genSpec);
+   }
+
+   /* Pipeline mode, generation and checking overlap and no array is kept */
+   if (pipeConsumers > 0) {
+	struct PipeResult_s res;
+	int outFd = -1;
+	struct stat st;
+	DECLARE_WTIMER(pipeTimer)
+
+	if (outPath != NULL) {
+	   outFd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	   if (outFd < 0) {
+	      printf("Can not open %s for export: %s\n", outPath, strerror(errno));
+	      exit(PGM_FILE_NOT_FOUND);
+	   }
+	   // The consumers write the chunks in any order at their own offsets
+	   if (fstat(outFd, &st) || !S_ISREG(st.st_mode)) {
+	      printf("The pipeline can only export to a regular file\n");
+	      exit(PGM_SYNTAX_ERROR);
+	   }
+	}
+	printf("\nStarting %d generator and %d consumer threads on %ld numbers\n\n",
+	       numThreads, pipeConsumers, dataSize);
+	START_NTIMER(pipeTimer);
+	if (pipeRun(pool, numThreads, pipeConsumers, pipeSlots, dataSize, chunk, &gen,
+	            kernel, outFd, &res)) {
+	   printf("Pipeline setup failed\n");
+	   exit(MALLOC_ERROR);
+	}
+	STOP_NTIMER(pipeTimer);
+	printf("Pipeline: %d slots of %ld elements, %.2f MB resident\n", res.slots, chunk,
+	       (double)res.slots*chunk*sizeof(elem_t)/1e6);
+	printf("Pipeline wall time = %.3f sec  %.2f GB/s\n", ELAPSED_NTIMER(pipeTimer),
+	       1e-9*dataSize*sizeof(elem_t)/ELAPSED_NTIMER(pipeTimer));
+	if (verbose) {
+	   printf("Chunks: %ld  generator waits: %ld  consumer waits: %ld\n",
+	          res.chunks, res.produceWaits, res.consumeWaits);
+	}
+	if (outFd >= 0 && (close(outFd) || res.writeError)) {
+	   printf("Export to %s failed: %s\n", outPath,
+	          strerror(res.writeError ? res.writeError : errno));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+
+	printf("Verifying results...  ");
+	if (res.firstError < dataSize) {
+	   printf("Error int_array[%ld] != %lld\n", res.firstError,
+	          (long long)genValue(&gen, res.firstError));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	if (gen.type == GEN_AFFINE && res.sum != affine_sum(&gen, dataSize)) {
+	   printf("Error sum %llu != %llu\n", (unsigned long long)res.sum,
+	          (unsigned long long)affine_sum(&gen, dataSize));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	printf("success  sum = %llu\n\n", (unsigned long long)res.sum);
+
+	poolDestroy(pool);
+	schedFree(&sched);
+	free(threadData);
+	free(progress);
+	free(rc_codes);
+	free(thread_stats);
+	free(cpus);
+	free(nodes);
+	return(PGM_SUCCESS);
+   } // End if pipeline
+
    // Print message before starting the timer
-   printf("\nStarting %d threads generating %d numbers\n\n", numThreads, dataSize);   
+   printf("\nStarting %d threads generating %ld numbers\n\n", numThreads, dataSize);   
 
  
    
-   // Spin up N threads
+   // Decide where each worker runs, falls back to one node without sysfs
+   if (placeWorkers(affinity, numThreads, cpus, nodes)) {
+	fprintf(stderr, "None of the CPUs in %s can be used\n", affinity);
+	exit(PGM_SYNTAX_ERROR);
+   }
+   if (verbose) {
+	printf("Affinity: %s on %d NUMA node(s)\n", affinity, placeNumNodes());
+   }
+
    for(int i = 0; i < numThreads; i++) {
       // Build the thread specific information
       threadData[i].threadID = i;
-      threadData[i].segSize = dataSize/numThreads;
-      threadData[i].dataPtr = &int_array[i*(dataSize/numThreads)];
+      threadData[i].segStart = (dataSize/numThreads)*i +
+                   ((i < dataSize%numThreads) ? i : dataSize%numThreads);
+      threadData[i].segSize = dataSize/numThreads + (i < dataSize%numThreads);
+      threadData[i].dataPtr = int_array;
+      threadData[i].sched = &sched;
+      threadData[i].touchStep = buffer.touchSize/sizeof(elem_t);
+      threadData[i].kernel = kernel;
+      threadData[i].fill = (stores == STORES_STREAM) ? fillStreamFunc(kernel) : fillFunc(kernel);
+      threadData[i].verify = verifyFunc(kernel);
+      threadData[i].gen = &gen;
+      threadData[i].workIters = workPerElem;
+      threadData[i].exporter = NULL;
+      threadData[i].syncBuf = (buffer.mode == MEM_FILE) ? &buffer : NULL;
+      threadData[i].stats = &thread_stats[i];
+      threadData[i].perf = perf;
       threadData[i].trackStatus = status;
       threadData[i].verbose = verbose;
-      
-      // Start the thread
-      int tc = pthread_create(&th_array[i], NULL, do_process, &threadData[i]);
+
+      // Pin the worker, a failure only costs locality
+      threadData[i].cpu = cpus[i];
+      threadData[i].node = nodes[i];
+      if (poolPin(pool, i, cpus[i])) {
+	fprintf(stderr, "Warning: could not pin thread %d to cpu %d\n", i, cpus[i]);
+	threadData[i].cpu = -1;
+      }
+      if (verbose && threadData[i].cpu >= 0) {
+	printf("Thread:%d  cpu:%d  node:%d\n", i, threadData[i].cpu, threadData[i].node);
+      }
+   } // End thread setup
+
+   /* Window mode, the sequence is made and checked but never kept */
+   if (window > 0) {
+	DECLARE_WTIMER(windowTimer)
+	struct rusage usage;
+	uelem_t total = 0;
+
+	// Each worker allocates its own window, see do_window
+	for(int i = 0; i < numThreads; i++) {
+	   threadData[i].window = (window < dataSize) ? window : dataSize;
+	   threadData[i].dataPtr = NULL;
+	}
+	first_error = dataSize;
+	START_NTIMER(windowTimer);
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_window);
+	STOP_NTIMER(windowTimer);
+	for(int i = 0; i < numThreads; i++) {
+	   if (threadData[i].dataPtr == NULL) {
+	      printf("Window allocation failed\n");
+	      exit(MALLOC_ERROR);
+	   }
+	   total += threadData[i].segSum;
+	   free(threadData[i].dataPtr);
+	}
+	printf("Window: %ld elements (%.0f KB) per thread\n", threadData[0].window,
+	       threadData[0].window*sizeof(elem_t)/1024.0);
+	printf("Window wall time = %.3f sec  %.2f GB/s\n", ELAPSED_NTIMER(windowTimer),
+	       1e-9*dataSize*sizeof(elem_t)/ELAPSED_NTIMER(windowTimer));
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+	   printf("Peak RSS = %.1f MB\n", usage.ru_maxrss/1024.0);
+	}
+
+	printf("Verifying results...  ");
+	if (first_error < dataSize) {
+	   printf("Error element %ld != %lld\n", first_error,
+	          (long long)genValue(&gen, first_error));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	if (gen.type == GEN_AFFINE && total != affine_sum(&gen, dataSize)) {
+	   printf("Error sum %llu != %llu\n", (unsigned long long)total,
+	          (unsigned long long)affine_sum(&gen, dataSize));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	printf("success  sum = %llu\n\n", (unsigned long long)total);
+
+	poolDestroy(pool);
+	schedFree(&sched);
+	free(threadData);
+	free(progress);
+	free(rc_codes);
+	free(thread_stats);
+	free(cpus);
+	free(nodes);
+	return(PGM_SUCCESS);
+   } // End if window
+
+   // Each worker first touches the pages of its own segment so they are
+   // allocated on its node.  The static policy fills its own segment anyway,
+   // the others at least take the page faults out of the fill.
+   // The pass is timed on its own so page fault cost is not fill time.
+   if (prefault || (placeAffinity(affinity) != AFFINITY_NONE && policy != POLICY_STATIC)) {
+	DECLARE_WTIMER(prefaultTimer)
+	START_NTIMER(prefaultTimer);
+	run_job(pool, threadData, numThreads, POLICY_STATIC, dataSize, chunk, do_touch);
+	STOP_NTIMER(prefaultTimer);
+	printf("Prefault wall time = %.3f sec\n", ELAPSED_NTIMER(prefaultTimer));
+   }
+
+   // The writer thread takes the chunks as the workers finish them
+   if (outPath != NULL) {
+	exporter = exportOpen(outPath, int_array, sizeof(elem_t), dataSize);
+	if (exporter == NULL) {
+	   printf("Can not open %s for export: %s\n", outPath, strerror(errno));
+	   exit(PGM_FILE_NOT_FOUND);
+	}
+	for(int i = 0; i < numThreads; i++) {
+	   threadData[i].exporter = exporter;
+	}
+	if (verbose) {
+	   printf("Export: %s with %s\n", outPath, exportEngine(exporter));
+	}
+   }
+
+   /* Print out the progress status from its own thread.  The workers signal
+      the reporter as soon as they start, so it is set up before them. */
+   if (status == 1) {
+	pthread_condattr_t attr;
+	pthread_mutex_init(&reporter.lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&reporter.cond, &attr);
+	pthread_condattr_destroy(&attr);
+	reporter.intervalMs = intervalMs;
+	reporter.total = dataSize;
+	reporter.numThreads = numThreads;
+	if (pthread_create(&reporterThread, NULL, do_report, &reporter)) {
+	   fprintf(stderr, "Failed to start the status reporter\n");
+	   exit(99);
+	}
+   } // end if status
+
+   // Hand the fill job to N workers
+   START_NTIMER(fillTimer);
+   for(int i = 0; i < numThreads; i++) {
+      // Start the job
+      int tc = poolStart(pool, i, do_process, &threadData[i]);
       if (tc) {
 	fprintf(stderr, "Failed to start thread tc: %d\n", tc);
 	exit(99);
       }
 
       if (verbose) {
-         fprintf(stdout, "Thread:%d  ID:%ld started\n", i, (unsigned long int)th_array[i]);
+         fprintf(stdout, "Thread:%d  ID:%ld started\n", i, (unsigned long int)poolThread(pool, i));
       }
    } // End threads  
  
-   /* Print out the progress status */
-   if (status == 1) {
-	pthread_mutex_lock(&lock);
-	while(processed < dataSize) 
-	{
-	   printf("Processed: %d lines %3.0f%% complete\n", processed, ((float)processed/(float)dataSize)*100);
-	   pthread_mutex_unlock(&lock);
-	   sleep(1);
-	   pthread_mutex_lock(&lock);
-	} // end while
-	pthread_mutex_unlock(&lock);
-   } // end if status
 
    /* Wait for all processes to end */
    for(int i = 0; i< numThreads; i++) {
- 	pthread_join(th_array[i], &rcp);
+ 	poolJoin(pool, i, &rcp);
    } // End threads  
-   
-   
+   STOP_NTIMER(fillTimer);
 
-   time_t  wallTimeEnd = time(NULL);;    // Used to report wall execution time.
-   printf("Total wall time = %d sec\n", (int)(wallTimeEnd-wallTime));
+   // Wake the reporter for its last line right away
+   if (status == 1) {
+	pthread_mutex_lock(&reporter.lock);
+	reporter.done = 1;
+	pthread_cond_signal(&reporter.cond);
+	pthread_mutex_unlock(&reporter.lock);
+	pthread_join(reporterThread, NULL);
+	pthread_cond_destroy(&reporter.cond);
+	pthread_mutex_destroy(&reporter.lock);
+   }
+   schedFree(&sched);
 
-   
+   printf("Fill wall time = %.3f sec\n", ELAPSED_NTIMER(fillTimer));
+   {
+	double cpuTotal = 0.0;
+	for(int i = 0; i < numThreads; i++) {
+	   cpuTotal += thread_stats[i].cpuSeconds;
+	   if (verbose) {
+	      printf("Thread:%d  fill cpu time = %.3f sec  chunk p50 %.1f us  p99 %.1f us\n",
+	             i, thread_stats[i].cpuSeconds,
+	             1e-3*histPercentile(&thread_stats[i].hist, 0.50),
+	             1e-3*histPercentile(&thread_stats[i].hist, 0.99));
+	   }
+	}
+	printf("Fill cpu time = %.3f sec over %d threads\n", cpuTotal, numThreads);
+	printf("Fill bandwidth = %.2f GB/s with %s stores\n",
+	       1e-9*dataSize*sizeof(elem_t)/ELAPSED_NTIMER(fillTimer),
+	       (stores == STORES_STREAM) ? "streaming" : "normal");
+   }
+   if (perf) {
+	int counted = 0;
+	for(int i = 0; i < numThreads; i++) {
+	   counted += print_counters(i, &threadData[i].counters, thread_stats[i].elements);
+	}
+	if (counted == 0 && verbose) {
+	   printf("Performance counters not available\n");
+	}
+   }
+   if (statsPath != NULL) {
+	struct RunStats_s run = {numThreads, dataSize, sizeof(elem_t),
+	                         ELAPSED_NTIMER(fillTimer), schedName(policy),
+	                         fillName(kernel), chunk};
+	if (statsWrite(statsPath, &run, thread_stats)) {
+	   printf("Can not write the statistics to %s: %s\n", statsPath, strerror(errno));
+	}
+   }
+
+   // The file buffer has been written back as the chunks finished, wait
+   // for the rest so the file is complete before it is read back
+   if (buffer.mode == MEM_FILE) {
+	DECLARE_WTIMER(flushTimer)
+	START_NTIMER(flushTimer);
+	if (bufFlush(&buffer)) {
+	   printf("Flush of %s failed: %s\n", memPath, strerror(errno));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	STOP_NTIMER(flushTimer);
+	printf("Flush wall time = %.3f sec\n", ELAPSED_NTIMER(flushTimer));
+   }
+
+   // Only the writes still queued when the fill ended add to the run time
+   if (exporter != NULL) {
+	const char *engine = exportEngine(exporter);
+	DECLARE_WTIMER(exportTimer)
+	START_NTIMER(exportTimer);
+	if (exportClose(exporter)) {
+	   printf("Export to %s failed: %s\n", outPath, strerror(errno));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	STOP_NTIMER(exportTimer);
+	printf("Export (%s) drain time = %.3f sec\n", engine, ELAPSED_NTIMER(exportTimer));
+	for(int i = 0; i < numThreads; i++) {
+	   threadData[i].exporter = NULL;
+	}
+   }
+   STOP_NTIMER(totalTimer);
+   printf("Total wall time = %.3f sec\n", ELAPSED_NTIMER(totalTimer));
 
-   printf("Verifying results...  ");
-   for (int i = 0; i < dataSize; i++) {
-       if (int_array[i] != 3*i) {
-         printf("Error int_array[%d]= %d != %d\n", i, int_array[i], 3*i); 
-          exit(PGM_INTERNAL_ERROR);}
+#ifdef HW13_TEST
+   // A known fault the checks below must find
+   if (inject >= 0) {
+	int_array[inject] ^= 1;
+	printf("Injected a fault at element %ld\n", inject);
+   }
+#endif
+
+   /* Digest of every segment against the generator's.  The element check
+      below then only runs to locate a mismatch. */
+   first_error = dataSize;
+   if (check == CHECK_DIGEST) {
+	struct Digest_s total;
+	int bad = -1;
+	// The closed form has no CRC, the affine CRC is only logged
+	int checkCrc = (gen.type != GEN_AFFINE);
+	DECLARE_WTIMER(digestTimer)
+
+	START_NTIMER(digestTimer);
+	run_job(pool, threadData, numThreads, POLICY_STATIC, dataSize, chunk, do_digest);
+	digestInit(&total);
+	for(int i = 0; i < numThreads; i++) {
+	   const struct Digest_s *d = &threadData[i].digest;
+	   const struct Digest_s *r = &threadData[i].refDigest;
+	   if (bad < 0 && (d->sum != r->sum || d->sumSq != r->sumSq ||
+	                   (checkCrc && d->crc != r->crc))) {
+	      bad = i;
+	   }
+	   digestCombine(&total, d);
+	}
+	STOP_NTIMER(digestTimer);
+	printf("Digest wall time = %.3f sec  %.2f GB/s\n", ELAPSED_NTIMER(digestTimer),
+	       1e-9*dataSize*sizeof(elem_t)/ELAPSED_NTIMER(digestTimer));
+	printf("Digest: n=%ld sum=%016llx sumsq=%016llx crc32c=%08x\n", total.count,
+	       (unsigned long long)total.sum, (unsigned long long)total.sumSq, total.crc);
+	if (verbose) {
+	   for(int i = 0; i < numThreads; i++) {
+	      const struct Digest_s *d = &threadData[i].digest;
+	      printf("  segment %d: start=%ld n=%ld sum=%016llx sumsq=%016llx crc32c=%08x\n",
+	             i, threadData[i].segStart, d->count, (unsigned long long)d->sum,
+	             (unsigned long long)d->sumSq, d->crc);
+	   }
+	}
+
+	if (!checkCrc) {
+	   printf("Only sum and sumsq are checked against the closed form\n");
+	}
+	printf("Checking digests...  ");
+	if (bad >= 0) {
+	   const struct Digest_s *d = &threadData[bad].digest;
+	   const struct Digest_s *r = &threadData[bad].refDigest;
+	   printf("Error segment %d [%ld, %ld) sum=%016llx sumsq=%016llx crc32c=%08x\n",
+	          bad, threadData[bad].segStart, threadData[bad].segStart + threadData[bad].segSize,
+	          (unsigned long long)d->sum, (unsigned long long)d->sumSq, d->crc);
+	   if (checkCrc) {
+	      printf("  != sum=%016llx sumsq=%016llx crc32c=%08x\n",
+	             (unsigned long long)r->sum, (unsigned long long)r->sumSq, r->crc);
+	   }
+	   else {
+	      printf("  != sum=%016llx sumsq=%016llx\n",
+	             (unsigned long long)r->sum, (unsigned long long)r->sumSq);
+	   }
+	   exit(PGM_INTERNAL_ERROR);
+	}
+   } // End if digest
+
+   /* Verify on the same workers, each one records the first mismatch it finds */
+   if (check == CHECK_ELEMENTS) {
+	printf("Verifying results...  ");
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_verify);
+   }
+   if (first_error < dataSize) {
+      long i = first_error;
+      printf("Error int_array[%ld]= %lld != %lld\n", i, (long long)int_array[i],
+             (long long)genValue(&gen, i)); 
+      exit(PGM_INTERNAL_ERROR);
    } // End verification
    printf("success\n\n");
 
+   /* The pages are mapped now, so one more pass with each kind of store
+      times the stores alone.  The streaming pass goes last and is checked. */
+   if (stores == STORES_BOTH) {
+	DECLARE_WTIMER(normalTimer)
+	DECLARE_WTIMER(streamTimer)
+	double bytes = (double)dataSize*sizeof(elem_t);
+
+	START_NTIMER(normalTimer);
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_store);
+	STOP_NTIMER(normalTimer);
+	for(int i = 0; i < numThreads; i++) {
+	   threadData[i].fill = fillStreamFunc(kernel);
+	}
+	START_NTIMER(streamTimer);
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_store);
+	STOP_NTIMER(streamTimer);
+	printf("Store bandwidth: normal %.2f GB/s  streaming %.2f GB/s\n",
+	       1e-9*bytes/ELAPSED_NTIMER(normalTimer), 1e-9*bytes/ELAPSED_NTIMER(streamTimer));
+
+	printf("Verifying results...  ");
+	first_error = dataSize;
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_verify);
+	if (first_error < dataSize) {
+	   long i = first_error;
+	   printf("Error int_array[%ld]= %lld != %lld\n", i, (long long)int_array[i],
+	          (long long)genValue(&gen, i));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	printf("success\n\n");
+   } // End if both stores
+
+   /* Reduction and prefix sum over the worker segments */
+   if (scan) {
+	DECLARE_WTIMER(reduceTimer)
+	DECLARE_WTIMER(scanTimer)
+	uelem_t total = 0;
+	double bytes = (double)dataSize*sizeof(elem_t);
+
+	START_NTIMER(reduceTimer);
+	run_job(pool, threadData, numThreads, POLICY_STATIC, dataSize, chunk, do_reduce);
+	// Exclusive scan of the segment sums gives each segment its offset
+	for(int i = 0; i < numThreads; i++) {
+	   threadData[i].segOffset = total;
+	   total += threadData[i].segSum;
+	}
+	STOP_NTIMER(reduceTimer);
+	printf("Reduce wall time = %.3f sec  %.2f GB/s  sum = %llu\n", ELAPSED_NTIMER(reduceTimer),
+	       1e-9*bytes/ELAPSED_NTIMER(reduceTimer), (unsigned long long)total);
+	if (gen.type == GEN_AFFINE && total != affine_sum(&gen, dataSize)) {
+	   printf("Error sum %llu != %llu\n", (unsigned long long)total,
+	          (unsigned long long)affine_sum(&gen, dataSize));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+
+	START_NTIMER(scanTimer);
+	run_job(pool, threadData, numThreads, POLICY_STATIC, dataSize, chunk, do_scan);
+	STOP_NTIMER(scanTimer);
+	printf("Scan wall time = %.3f sec  %.2f GB/s\n", ELAPSED_NTIMER(scanTimer),
+	       2e-9*bytes/ELAPSED_NTIMER(scanTimer));
+
+	// The last running total is the sum, every element is checked in parallel
+	printf("Checking the scan...  ");
+	first_error = ((uelem_t)int_array[dataSize - 1] == total) ? dataSize : dataSize - 1;
+	run_job(pool, threadData, numThreads, POLICY_STATIC, dataSize, chunk, do_scan_check);
+	if (first_error < dataSize) {
+	   long i = first_error;
+	   printf("Error scan[%ld]= %lld is wrong\n", i, (long long)int_array[i]);
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	printf("success\n\n");
+   } // End if scan
+
+   /* Read and write bandwidth on the same workers, growing thread counts */
+   if (streamSize > 0) {
+	struct Buffer_s streamBuf[3];
+	double gbps[STREAM_KERNELS], triad1 = 0.0;
+	int mode = (memMode == MEM_FILE) ? MEM_MMAP : memMode;
+
+	for(int k = 0; k < 3; k++) {
+	   if (bufAlloc(&streamBuf[k], streamSize*sizeof(double), mode)) {
+	      printf("STREAM array %s allocation failed\n", bufName(mode));
+	      exit(MALLOC_ERROR);
+	   }
+	}
+	printf("STREAM GB/s with %ld doubles per array (%.1f MB each), best of %d\n",
+	       streamSize, streamSize*sizeof(double)/1e6, STREAM_REPS);
+	printf("Threads");
+	for(int k = 0; k < STREAM_KERNELS; k++) {
+	   printf(" %7s", streamName(k));
+	}
+	printf("  triad speedup\n");
+	// Powers of two, then all the threads
+	for(int t = 1; ; t = (2*t < numThreads) ? 2*t : numThreads) {
+	   if (streamBench(pool, t, streamBuf[0].ptr, streamBuf[1].ptr, streamBuf[2].ptr,
+	                   streamSize, gbps)) {
+	      printf("STREAM results are wrong with %d threads\n", t);
+	      exit(PGM_INTERNAL_ERROR);
+	   }
+	   triad1 = (t == 1) ? gbps[STREAM_TRIAD] : triad1;
+	   printf("%7d", t);
+	   for(int k = 0; k < STREAM_KERNELS; k++) {
+	      printf(" %7.2f", gbps[k]);
+	   }
+	   printf(" %14.2f\n", (triad1 > 0.0) ? gbps[STREAM_TRIAD]/triad1 : 0.0);
+	   if (t == numThreads) {
+	      break;
+	   }
+	} // End for thread counts
+	printf("\n");
+	for(int k = 0; k < 3; k++) {
+	   bufFree(&streamBuf[k]);
+	}
+   } // End if stream
+
+   /* Refill the cleared array as many small requests to the fill engine,
+      all submitted before the first wait so they run back to back */
+   if (submits > 0) {
+	struct Engine_s *eng;
+	struct Future_s **futures;
+	long per = (dataSize + submits - 1)/submits;
+	DECLARE_WTIMER(submitTimer)
+
+	submits = (dataSize + per - 1)/per;
+	futures = malloc(submits*sizeof(*futures));
+	eng = engineCreate(numThreads, kernel, chunk);
+	if (futures == NULL || eng == NULL) {
+	   printf("Fill engine creation failed\n");
+	   exit(MALLOC_ERROR);
+	}
+	memset(int_array, 0, dataSize*sizeof(elem_t));
+	START_NTIMER(submitTimer);
+	for(long r = 0; r < submits; r++) {
+	   long first = r*per;
+	   long count = (first + per < dataSize) ? per : dataSize - first;
+	   futures[r] = engineSubmit(eng, &int_array[first], first, count, &gen);
+	   if (futures[r] == NULL) {
+	      printf("Request %ld could not be submitted\n", r);
+	      exit(MALLOC_ERROR);
+	   }
+	}
+	for(long r = 0; r < submits; r++) {
+	   futureWait(futures[r]);
+	   futureFree(futures[r]);
+	}
+	STOP_NTIMER(submitTimer);
+	engineDestroy(eng);
+	free(futures);
+	printf("Submit wall time = %.3f sec for %ld requests of %ld elements, %.1f us each\n",
+	       ELAPSED_NTIMER(submitTimer), submits, per, 1e6*ELAPSED_NTIMER(submitTimer)/submits);
+
+	printf("Verifying results...  ");
+	first_error = dataSize;
+	run_job(pool, threadData, numThreads, policy, dataSize, chunk, do_verify);
+	if (first_error < dataSize) {
+	   long i = first_error;
+	   printf("Error int_array[%ld]= %lld != %lld\n", i, (long long)int_array[i],
+	          (long long)genValue(&gen, i));
+	   exit(PGM_INTERNAL_ERROR);
+	}
+	printf("success\n\n");
+   } // End if submits
+
    
    // Clean up
-free(int_array);
+poolDestroy(pool);
+bufFree(&buffer);
+free(threadData);
+free(progress);
+free(rc_codes);
+free(thread_stats);
+free(cpus);
+free(nodes);
 pthread_exit(NULL);
 return(0); 
    } // End main
@@ -231,8 +1260,10 @@ return(0);
    
 /****************************************************************************
   This threading process will initialize parts of a very large array by 3's
-  It contains code to SLOW execution down so that status updates can be easily
-  seen.  The function prototype is defined by pthread so we MUST use it.
+  It keeps taking chunks of the array from the scheduler until none are left.
+  The synthetic work of work.h slows it down so that status updates can be
+  easily seen.  The function prototype is defined by pthread so we MUST use it, the
+  pool runs it like a thread routine.
   
   void *do_process(void *data)
   Where: void *data - pointer to some user defined data structure
@@ -244,20 +1275,27 @@ return(0);
 ****************************************************************************/
 void *do_process(void *data) {
    struct ThreadData_s* data_0 = data;
-   int counter = 0;
-//   volatile int processed = 0;
-//   pthread_mutex_t lock;
-   int lim = (data_0->segSize) * (STATUS_UPDATE_RATE/100);
-   int start = (data_0->segSize) * (data_0->threadID);
- 
-   if (pthread_mutex_init(&lock, NULL)) {
-	printf("mutex initialization failed in do_process\n");
-	exit(99);
-   }
+   long counter = 0;
+   long done = 0;     // Running total published in this thread's progress slot
+   long lim = (data_0->segSize*STATUS_UPDATE_RATE)/100 + 1;
+   long mark = lim;   // Next milestone for the reporter
+   double sink = 0.0; // Sum of the synthetic work results
+   long begin, end;
+   DECLARE_TTIMER(cpuTimer)
+   DECLARE_WTIMER(busyTimer)
+   DECLARE_WTIMER(chunkTimer)
 
+   START_NTIMER(cpuTimer);
+   START_NTIMER(busyTimer);
+   histReset(&data_0->stats->hist);
+   data_0->stats->elements = 0;
+   if (data_0->perf) {
+      perfOpen(&data_0->counters);
+      perfStart(&data_0->counters);
+   }
    // Print out the thread status
    if (data_0->verbose) {
-      fprintf(stdout, "Thread:%d  track status:%d  seg size:%dKB  data ptr:%p\n", data_0->threadID, data_0->trackStatus, data_0->segSize, (void *)data_0->dataPtr );
+      fprintf(stdout, "Thread:%d  track status:%d  seg size:%ldKB  data ptr:%p\n", data_0->threadID, data_0->trackStatus, data_0->segSize, (void *)&data_0->dataPtr[data_0->segStart] );
       fflush(stdout);
    } // End verbose
    
@@ -268,23 +1306,37 @@ void *do_process(void *data) {
          fprintf(stdout, "Thread: %d\n", data_0->threadID);
          fflush(stdout);
          } // End verbose
-   for (int i = start; i < start+(data_0->segSize); i++) {
-      data_0->dataPtr [i-start] = 3*i;
+   while (schedNext(data_0->sched, data_0->threadID, &begin, &end)) {
+   RESET_NTIMER(chunkTimer);
+   START_NTIMER(chunkTimer);
+   // The vector kernels store the whole chunk at full speed
+   if (data_0->kernel != KERNEL_SCALAR) {
+      engineRange(data_0->gen, data_0->fill, &data_0->dataPtr[begin], begin, end - begin);
+      if (data_0->workIters > 0) {
+	 sink += workChunk(&data_0->dataPtr[begin], end - begin, data_0->workIters);
+      }
+      if (data_0->trackStatus) {
+	 done += end - begin;
+	 publish_progress(data_0, done, &mark, lim);
+      }
+      STOP_NTIMER(chunkTimer);
+      chunk_done(data_0, begin, end, ELAPSED_NTIMER(chunkTimer));
+      continue;
+   } // End if vector
+
+   // Scalar reference loop
+   for (long i = begin; i < end; i++) {
+      data_0->dataPtr [i] = genValue(data_0->gen, i);
      
-      // Slow the CPU
-      int delay = 1<<DELAY_LOOPS_EXP;
-      while (delay)
-         {
-         delay--;
-         }
+      // Slow the CPU with work the compiler can not remove
+      sink += workElem((double)data_0->dataPtr[i], data_0->workIters);
      
       counter++;
       // Track status if required
 	if((data_0->trackStatus) && counter>=lim) {
-	   pthread_mutex_lock(&lock);
-	   processed += counter;
+	   done += counter;
 	   counter = 0;
-	   pthread_mutex_unlock(&lock);
+	   publish_progress(data_0, done, &mark, lim);
 	      
  /* 
       // Print out the thread status
@@ -294,16 +1346,557 @@ void *do_process(void *data) {
          } // End verbose  */
       } // End if
    } // End i
+   if ((data_0->trackStatus) && counter > 0) {
+      done += counter;
+      counter = 0;
+      publish_progress(data_0, done, &mark, lim);
+   }
+   STOP_NTIMER(chunkTimer);
+   chunk_done(data_0, begin, end, ELAPSED_NTIMER(chunkTimer));
+   } // End chunks
   
-   // There might be some status left to update
-   if (data_0->trackStatus) {
-	pthread_mutex_lock(&lock);
-	processed += counter;
-	pthread_mutex_unlock(&lock);
+   if (data_0->perf) {
+      perfStop(&data_0->counters);
+      perfClose(&data_0->counters);
    }
+   data_0->workSink = sink;
+   STOP_NTIMER(busyTimer);
+   STOP_NTIMER(cpuTimer);
+   data_0->stats->busySeconds = ELAPSED_NTIMER(busyTimer);
+   data_0->stats->cpuSeconds = ELAPSED_NTIMER(cpuTimer);
 
    // Return the task ID number + 10
-   rc_codes[data_0->threadID] = data_0->threadID + STATUS_UPDATE_RATE;
-   pthread_exit(&rc_codes[data_0->threadID]);
-   //return(       );
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
 } // End do_process
+
+
+/****************************************************************************
+  Hand a filled chunk on: record its time, queue it for export and start
+  writing back the pages of a file buffer so dirty pages do not pile up in
+  memory.
+
+  void chunk_done(struct ThreadData_s *data, long begin, long end,
+                  double seconds)
+  Where: struct ThreadData_s *data - the worker's data
+         long begin                - first element index of the chunk
+         long end                  - one past the last element index
+         double seconds            - time the chunk took to fill
+  Returns: nothing
+  Errors: a failed write back is caught by the flush after the fill
+****************************************************************************/
+void chunk_done(struct ThreadData_s *data, long begin, long end, double seconds) {
+   histAdd(&data->stats->hist, (long long)(seconds*1e9));
+   data->stats->elements += end - begin;
+   if (data->exporter != NULL) {
+      exportChunk(data->exporter, begin, end);
+   }
+   if (data->syncBuf != NULL) {
+      bufSync(data->syncBuf, begin*sizeof(elem_t), (end - begin)*sizeof(elem_t));
+   }
+} // End chunk_done
+
+
+/****************************************************************************
+  Print the hardware counts of one worker scaled to its elements, leaving
+  out what could not be counted.  IPC needs both cycles and instructions.
+
+  int print_counters(int thread, const struct Perf_s *perf, long elements)
+  Where: int thread              - worker number
+         const struct Perf_s *perf - the worker's counts
+         long elements           - elements the worker filled
+  Returns: int - 1 if a line was printed, 0 if nothing was counted
+  Errors: none
+****************************************************************************/
+int print_counters(int thread, const struct Perf_s *perf, long elements) {
+   double per = (elements > 0) ? 1.0/elements : 0.0;
+   int any = 0;
+
+   for (int e = 0; e < PERF_EVENTS; e++) {
+      any |= perfValid(perf, e);
+   }
+   if (!any) {
+      return(0);
+   }
+   printf("Thread:%d  perf:", thread);
+   if (perfValid(perf, PERF_CYCLES) && perfValid(perf, PERF_INSTRUCTIONS)) {
+      printf("  IPC %.2f", (perf->value[PERF_CYCLES] > 0) ?
+             (double)perf->value[PERF_INSTRUCTIONS]/perf->value[PERF_CYCLES] : 0.0);
+   }
+   if (perfValid(perf, PERF_CYCLES)) {
+      printf("  cycles/elem %.3f", perf->value[PERF_CYCLES]*per);
+   }
+   if (perfValid(perf, PERF_LLC_MISSES)) {
+      printf("  LLC misses/elem %.5f", perf->value[PERF_LLC_MISSES]*per);
+   }
+   if (perfValid(perf, PERF_DTLB_MISSES)) {
+      printf("  dTLB misses/elem %.6f", perf->value[PERF_DTLB_MISSES]*per);
+   }
+   if (perfValid(perf, PERF_PAGE_FAULTS)) {
+      printf("  faults/elem %.6f", perf->value[PERF_PAGE_FAULTS]*per);
+   }
+   printf("\n");
+   return(1);
+} // End print_counters
+
+
+/****************************************************************************
+  Sum the per-thread progress slots.  Each slot is only written by its own
+  worker so a relaxed read of every slot is enough for status reporting.
+
+  long total_processed(int numThreads)
+  Where: int numThreads - number of worker threads
+  Returns: long - number of elements processed so far
+  Errors: none
+****************************************************************************/
+long total_processed(int numThreads) {
+   long total = 0;
+
+   for (int i = 0; i < numThreads; i++) {
+      total += __atomic_load_n(&progress[i].processed, __ATOMIC_RELAXED);
+   }
+   return(total);
+} // End total_processed
+
+
+/****************************************************************************
+  Publish a worker's running total in its progress slot.  Each time the
+  total passes another milestone, STATUS_UPDATE_RATE percent of the
+  worker's segment size, the reporter is woken so it does not have to wait
+  for its next tick.
+
+  void publish_progress(struct ThreadData_s *data, long done, long *mark,
+                        long lim)
+  Where: struct ThreadData_s *data - the worker's data
+         long done                 - elements the worker filled so far
+         long *mark                - the worker's next milestone, advanced
+         long lim                  - elements between two milestones
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void publish_progress(struct ThreadData_s *data, long done, long *mark, long lim) {
+   __atomic_store_n(&progress[data->threadID].processed, done, __ATOMIC_RELAXED);
+   if (done >= *mark) {
+      while (*mark <= done) {
+         *mark += lim;
+      }
+      pthread_mutex_lock(&reporter.lock);
+      reporter.milestone = 1;
+      pthread_cond_signal(&reporter.cond);
+      pthread_mutex_unlock(&reporter.lock);
+   }
+} // End publish_progress
+
+
+/****************************************************************************
+  The status reporter thread.  Prints the progress, rate and estimated time
+  left on every tick of the interval and on every milestone, but only when
+  the count changed, and once more as soon as main reports the end of the
+  fill.
+
+  void *do_report(void *data)
+  Where: void *data - the struct Reporter_s
+  Returns: void *   - NULL
+  Errors: none
+****************************************************************************/
+void *do_report(void *data) {
+   struct Reporter_s *rep = data;
+   struct timespec tick;
+   long last = -1;
+   int done = 0;
+   DECLARE_WTIMER(runTimer)
+
+   START_NTIMER(runTimer);
+   clock_gettime(CLOCK_MONOTONIC, &tick);
+   while (!done) {
+      long processed;
+      double elapsed, rate;
+
+      // Sleep until the next tick unless a milestone or the end comes first
+      tick.tv_sec += rep->intervalMs/1000;
+      tick.tv_nsec += (rep->intervalMs%1000)*1000000L;
+      if (tick.tv_nsec >= 1000000000L) {
+         tick.tv_sec++;
+         tick.tv_nsec -= 1000000000L;
+      }
+      pthread_mutex_lock(&rep->lock);
+      while (!rep->done && !rep->milestone &&
+             pthread_cond_timedwait(&rep->cond, &rep->lock, &tick) == 0) {
+      }
+      rep->milestone = 0;
+      done = rep->done;
+      pthread_mutex_unlock(&rep->lock);
+
+      processed = total_processed(rep->numThreads);
+      if (processed == last) {
+         continue;
+      }
+      last = processed;
+      elapsed = ELAPSED_NTIMER(runTimer);
+      rate = (elapsed > 0.0) ? processed/elapsed : 0.0;
+      printf("Processed: %ld lines %3.0f%% complete  %.3g lines/sec", processed,
+             ((double)processed/(double)rep->total)*100, rate);
+      if (processed < rep->total && rate > 0.0) {
+         printf("  ETA %.1f sec", (rep->total - processed)/rate);
+      }
+      printf("\n");
+      fflush(stdout);
+   } // End while
+   return(NULL);
+} // End do_report
+
+
+/****************************************************************************
+  This threading process verifies chunks of the array against the 3's
+  sequence.  A mismatch lowers first_error, chunks that start above the
+  lowest mismatch found so far are skipped, so the final first_error is the
+  exact first failing index.
+
+  void *do_verify(void *data)
+  Where: void *data - pointer to struct ThreadData_s
+  Returns: void *   - pointer to this thread's return code
+  Errors: none
+****************************************************************************/
+void *do_verify(void *data) {
+   struct ThreadData_s* data_0 = data;
+   long begin, end, bad;
+
+   while (schedNext(data_0->sched, data_0->threadID, &begin, &end)) {
+      if (begin >= __atomic_load_n(&first_error, __ATOMIC_RELAXED)) {
+         continue;
+      }
+      bad = begin + engineCheck(data_0->gen, data_0->verify, &data_0->dataPtr[begin],
+                                begin, end - begin);
+      if (bad >= end) {
+         continue;
+      }
+
+      record_error(bad);
+   } // End chunks
+
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_verify
+
+
+/****************************************************************************
+  Keep the lowest mismatch of all the threads in first_error
+
+  void record_error(long bad)
+  Where: long bad - index of a mismatch
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void record_error(long bad) {
+   long cur = __atomic_load_n(&first_error, __ATOMIC_RELAXED);
+
+   while (bad < cur && !__atomic_compare_exchange_n(&first_error, &cur, bad,
+                        0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+   }
+} // End record_error
+
+
+/****************************************************************************
+  These threading processes run the reduce-then-scan passes over the
+  worker's own segment (see scan.h), the scheduler is not used.
+  do_reduce sums the segment, do_scan replaces it with its running totals
+  starting from the segment offset and do_scan_check checks them: against
+  the closed form for an affine generator, else by comparing the
+  difference of neighbouring totals with the generator.
+
+  void *do_reduce(void *data)
+  void *do_scan(void *data)
+  void *do_scan_check(void *data)
+  Where: void *data - pointer to the worker's struct ThreadData_s
+  Returns: void *   - pointer to the worker's return code
+  Errors: none
+****************************************************************************/
+void *do_reduce(void *data) {
+   struct ThreadData_s* data_0 = data;
+
+   data_0->segSum = scanSum(&data_0->dataPtr[data_0->segStart], data_0->segSize);
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_reduce
+
+
+/****************************************************************************
+  This threading process digests the worker's own segment as it is in
+  memory and sets up the reference digest.  The affine sums follow in
+  closed form, which has no CRC, so the reference CRC is left unset and
+  main does not compare it.  Other generators are regenerated with the worker's kernel a
+  window at a time, so the reference stays in the cache.  The scheduler is
+  not used.
+
+  void *do_digest(void *data)
+  Where: void *data - pointer to the worker's struct ThreadData_s
+  Returns: void *   - pointer to the worker's return code
+  Errors: none
+****************************************************************************/
+void *do_digest(void *data) {
+   struct ThreadData_s* data_0 = data;
+   elem_t win[DIGEST_WINDOW];
+   long end = data_0->segStart + data_0->segSize;
+
+   digestInit(&data_0->digest);
+   digestAdd(&data_0->digest, &data_0->dataPtr[data_0->segStart], data_0->segSize);
+
+   digestInit(&data_0->refDigest);
+   if (digestSums(data_0->gen, data_0->segStart, data_0->segSize,
+                  &data_0->refDigest.sum, &data_0->refDigest.sumSq) == 0) {
+      data_0->refDigest.count = data_0->segSize;
+   }
+   else {
+      FillFn_t fill = fillFunc(data_0->kernel);
+      for (long i = data_0->segStart; i < end; i += DIGEST_WINDOW) {
+         long n = (end - i < DIGEST_WINDOW) ? end - i : DIGEST_WINDOW;
+         engineRange(data_0->gen, fill, win, i, n);
+         digestAdd(&data_0->refDigest, win, n);
+      }
+   }
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_digest
+
+void *do_scan(void *data) {
+   struct ThreadData_s* data_0 = data;
+
+   scanInclusive(&data_0->dataPtr[data_0->segStart], data_0->segSize, data_0->segOffset);
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_scan
+
+void *do_scan_check(void *data) {
+   struct ThreadData_s* data_0 = data;
+   const elem_t *s = data_0->dataPtr;
+   const struct Gen_s *gen = data_0->gen;
+   long end = data_0->segStart + data_0->segSize;
+
+   if (gen->type == GEN_AFFINE) {
+      for (long i = data_0->segStart; i < end; i++) {
+         if ((uelem_t)s[i] != affine_sum(gen, i + 1)) {
+            record_error(i);
+            break;
+         }
+      }
+   }
+   else {
+      uelem_t prev = (data_0->segStart > 0) ? (uelem_t)s[data_0->segStart - 1] : 0;
+      for (long i = data_0->segStart; i < end; i++) {
+         if ((uelem_t)s[i] - prev != (uelem_t)genValue(gen, i)) {
+            record_error(i);
+            break;
+         }
+         prev = (uelem_t)s[i];
+      }
+   }
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_scan_check
+
+
+/****************************************************************************
+  Closed form of the sum of the first n elements of an affine generator,
+  a*n*(n-1)/2 + b*n.  The halving is done on the even factor before the
+  product so the result is exact modulo the element width.
+
+  uelem_t affine_sum(const struct Gen_s *gen, long n)
+  Where: const struct Gen_s *gen - an affine generator
+         long n                  - number of elements
+  Returns: uelem_t - the sum, wrapped
+  Errors: none
+****************************************************************************/
+uelem_t affine_sum(const struct Gen_s *gen, long n) {
+   uint64_t t = (n%2 == 0) ? (uint64_t)(n/2)*(uint64_t)(n - 1)
+                           : (uint64_t)n*(uint64_t)((n - 1)/2);
+
+   return((uelem_t)gen->coef[1]*(uelem_t)t + (uelem_t)gen->coef[0]*(uelem_t)n);
+} // End affine_sum
+
+
+/****************************************************************************
+  This threading process touches one element per page of its chunks so
+  that the kernel allocates the pages on the node of the touching thread
+  and the fill no longer takes the page faults.  It is run with the static
+  policy so every worker touches its own segment.
+
+  void *do_touch(void *data)
+  Where: void *data - pointer to struct ThreadData_s
+  Returns: void *   - pointer to this thread's return code
+  Errors: none
+****************************************************************************/
+void *do_touch(void *data) {
+   struct ThreadData_s* data_0 = data;
+   long begin, end;
+
+   while (schedNext(data_0->sched, data_0->threadID, &begin, &end)) {
+      for (long i = begin; i < end; i += data_0->touchStep) {
+         data_0->dataPtr[i] = 0;
+      }
+   } // End chunks
+
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_touch
+
+
+/****************************************************************************
+  This threading process only stores its chunks again with the worker's
+  fill kernel, no work, statistics or export, so the store bandwidth of a
+  kernel can be timed on pages that are already mapped.
+
+  void *do_store(void *data)
+  Where: void *data - pointer to struct ThreadData_s
+  Returns: void *   - pointer to this thread's return code
+  Errors: none
+****************************************************************************/
+void *do_store(void *data) {
+   struct ThreadData_s* data_0 = data;
+   long begin, end;
+
+   while (schedNext(data_0->sched, data_0->threadID, &begin, &end)) {
+      engineRange(data_0->gen, data_0->fill, &data_0->dataPtr[begin], begin, end - begin);
+   } // End chunks
+
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_store
+
+
+/****************************************************************************
+  This threading process fills and checks its chunks a window at a time in
+  its own small buffer, so the logical size can be far larger than memory.
+  The window is rewritten for every piece and stays in the cache, mismatches
+  go to first_error and the elements are summed into segSum.  The worker
+  allocates and first touches the window itself so its pages are on the
+  worker's node, main frees it.
+
+  void *do_window(void *data)
+  Where: void *data - pointer to struct ThreadData_s, dataPtr receives the
+                      window, NULL if it could not be allocated
+  Returns: void *   - pointer to this thread's return code
+  Errors: none
+****************************************************************************/
+void *do_window(void *data) {
+   struct ThreadData_s* data_0 = data;
+   elem_t *win;
+   uelem_t sum = 0;
+   double sink = 0.0;
+   long begin, end, n, off;
+
+   // Main reports the failure, the other workers take the chunks
+   if (posix_memalign((void **)&win, CACHE_LINE_SIZE, data_0->window*sizeof(elem_t))) {
+      data_0->dataPtr = NULL;
+      rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+      return(&rc_codes[data_0->threadID].rc);
+   }
+   memset(win, 0, data_0->window*sizeof(elem_t));
+   data_0->dataPtr = win;
+
+   while (schedNext(data_0->sched, data_0->threadID, &begin, &end)) {
+      for (long i = begin; i < end; i += n) {
+         n = (end - i < data_0->window) ? end - i : data_0->window;
+         engineRange(data_0->gen, data_0->fill, win, i, n);
+         if (data_0->workIters > 0) {
+            sink += workChunk(win, n, data_0->workIters);
+         }
+         off = engineCheck(data_0->gen, data_0->verify, win, i, n);
+         if (off < n) {
+            record_error(i + off);
+         }
+         sum += scanSum(win, n);
+      }
+   } // End chunks
+   data_0->segSum = sum;
+   data_0->workSink = sink;
+
+   rc_codes[data_0->threadID].rc = data_0->threadID + STATUS_UPDATE_RATE;
+   return(&rc_codes[data_0->threadID].rc);
+} // End do_window
+
+
+/****************************************************************************
+  Run one job routine on all the workers with its own scheduler and wait
+  for it to finish.  Exits the program if the job can not be started.
+
+  void run_job(struct Pool_s *pool, struct ThreadData_s *threadData,
+               int numThreads, int policy, long count, long chunk,
+               void *(*fn)(void *))
+  Where: struct Pool_s *pool             - the worker pool
+         struct ThreadData_s *threadData - per-worker information
+         int numThreads                  - number of workers
+         int policy                      - chunk scheduling policy
+         long count                      - number of elements to process
+         long chunk                      - elements per chunk
+         void *(*fn)(void *)             - the job routine
+  Returns: nothing
+  Errors: exits with 99 on failure
+****************************************************************************/
+void run_job(struct Pool_s *pool, struct ThreadData_s *threadData,
+             int numThreads, int policy, long count, long chunk,
+             void *(*fn)(void *)) {
+   struct Sched_s sched;
+   struct Sched_s *saved = threadData[0].sched;
+
+   if (schedInit(&sched, policy, count, chunk, numThreads)) {
+	fprintf(stderr, "Failed to initialize the %s scheduler\n", schedName(policy));
+	exit(99);
+   }
+   for (int i = 0; i < numThreads; i++) {
+      threadData[i].sched = &sched;
+      if (poolStart(pool, i, fn, &threadData[i])) {
+	fprintf(stderr, "Failed to start thread %d\n", i);
+	exit(99);
+      }
+   } // End threads
+   for (int i = 0; i < numThreads; i++) {
+      poolJoin(pool, i, NULL);
+   } // End threads
+   schedFree(&sched);
+
+   // Leave the fill scheduler in place for the caller
+   for (int i = 0; i < numThreads; i++) {
+      threadData[i].sched = saved;
+   }
+} // End run_job
+
+
+/****************************************************************************
+  Count the CPUs this process may run on, honoring cpusets and taskset
+
+  int online_cpus(void)
+  Returns: int - number of usable CPUs, at least 1
+  Errors: none
+****************************************************************************/
+int online_cpus(void) {
+   cpu_set_t set;
+   int n = 0;
+
+   if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      n = CPU_COUNT(&set);
+   }
+   if (n < 1) {
+      n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   return((n < 1) ? 1 : n);
+} // End online_cpus
+
+
+/****************************************************************************
+  Allocate zeroed memory starting on a cache line boundary
+
+  void *alloc_lines(size_t size)
+  Where: size_t size - number of bytes
+  Returns: void * - the memory, free it with free()
+  Errors: exits with MALLOC_ERROR on failure
+****************************************************************************/
+void *alloc_lines(size_t size) {
+   void *p;
+
+   if (posix_memalign(&p, CACHE_LINE_SIZE, size)) {
+      printf("thread information malloc failed\n");
+      exit(MALLOC_ERROR);
+   }
+   memset(p, 0, size);
+   return(p);
+} // End alloc_lines
@@ -0,0 +1,475 @@
+//  Contention microbenchmark for the shared progress counter
+//
+//  exercise/lab_d.c and hw13 count the work done in one global counter
+//  guarded by a pthread mutex.  This program runs that increment by itself
+//  under several synchronization schemes at rising thread counts and
+//  reports the throughput and how evenly the threads got their turn.
+//
+//   gcc -g -O0 -std=c99 lockbench.c -lpthread -o lockbench -Wall -pedantic
+//   ./lockbench -t 8 -d 200
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#define EN_TIME
+#include "Timers.h"
+#include "ClassErrors.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Size used to keep data on separate cache lines, same as pool.h
+#define CACHE_LINE_SIZE     (64)
+
+// Largest thread count and default milliseconds per measurement
+#define MAX_THREADS         (64)
+#define DEFAULT_DURATION_MS (200)
+
+// The synchronization schemes
+#define LOCK_MUTEX          (0)   // pthread mutex, as in lab_d and hw13
+#define LOCK_SPIN           (1)   // pthread spinlock
+#define LOCK_TICKET         (2)   // FIFO ticket lock
+#define LOCK_ATOMIC         (3)   // atomic fetch-add on the shared counter
+#define LOCK_SHARD          (4)   // per-thread counters packed in one array
+#define LOCK_PADDED         (5)   // per-thread counters on their own lines
+#define LOCK_METHODS        (6)
+
+static const char *methodNames[LOCK_METHODS] = {
+   "mutex", "spin", "ticket", "atomic", "shard", "padded"
+};
+
+// Spin wait hint, lets the sibling hyperthread run
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX()         __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+// Ticket lock, a waiter takes the next ticket and spins until it is served
+struct Ticket_s {
+   unsigned next;
+   unsigned serving;
+};
+
+// A per-thread counter alone on its cache line
+struct PaddedCount_s {
+   long count;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// The state all the threads fight over, each part on its own line so the
+// only sharing is the one the method under test asks for
+struct Shared_s {
+   pthread_mutex_t mutex __attribute__((aligned(CACHE_LINE_SIZE)));
+   pthread_spinlock_t spin __attribute__((aligned(CACHE_LINE_SIZE)));
+   struct Ticket_s ticket __attribute__((aligned(CACHE_LINE_SIZE)));
+   long processed __attribute__((aligned(CACHE_LINE_SIZE)));
+   long shard[MAX_THREADS] __attribute__((aligned(CACHE_LINE_SIZE)));
+   struct PaddedCount_s padded[MAX_THREADS];
+   int stop __attribute__((aligned(CACHE_LINE_SIZE)));
+   pthread_barrier_t start;
+};
+
+// One thread's part of a measurement
+struct Worker_s {
+   int id;
+   int method;
+   struct Shared_s *shared;
+   long ops;                  // Increments this thread made
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Result of one measurement
+struct Result_s {
+   long total;                // Increments of all threads
+   double seconds;            // Wall time of the measurement
+   double fairness;           // Jain's index of the per-thread counts
+   double minMax;             // Smallest over largest per-thread count
+};
+
+/* Function prototypes */
+void *worker(void *arg);
+void measure(struct Shared_s *shared, int method, int numThreads, long durationMs,
+             int verbose, struct Result_s *res);
+long counter_value(struct Shared_s *shared, int method, int numThreads);
+int lock_method(const char *name);
+int online_cpus(void);
+void Usage(char *argv[]);
+
+
+/*---------------------------------------------------------------------------
+  Run every method at 1, 2, 4... up to the maximum thread count and print
+  a table, or CSV to a file with -o
+---------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+   int rc;
+   int verbose = 0;
+   int maxThreads = online_cpus();
+   long durationMs = DEFAULT_DURATION_MS;
+   int only = -1;          // Single method to run, -1 for all
+   char *outPath = NULL;
+   FILE *out = NULL;
+   struct Shared_s *shared;
+   struct Result_s res;
+   int counts[MAX_THREADS + 1];
+   int numCounts = 0;
+
+   int option_index = 0;
+   char *getoptOptions = "t:d:m:o:v";
+   struct option long_options[] = {
+	{"threads", required_argument, 0, 't'}, //largest thread count, optional
+	{"duration", required_argument, 0, 'd'}, //ms per measurement, optional
+	{"method", required_argument, 0, 'm'},  //run one method only, optional
+	{"out", required_argument, 0, 'o'},     //CSV results file, optional
+	{"verbose", no_argument, 0, 'v'},
+	{"verb", no_argument, 0, 'v'},
+	{0, 0, 0, 0}
+   };
+
+   opterr = 1;
+   while ((rc = getopt_long_only(argc, argv, getoptOptions, long_options,
+						&option_index)) != -1) {
+	switch(rc)
+	{
+	  case 't':
+	  maxThreads = atoi(optarg);
+	  if (maxThreads < 1 || maxThreads > MAX_THREADS) {
+		printf("Number of threads should be 1 to %d\n", MAX_THREADS);
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'd':
+	  durationMs = atol(optarg);
+	  if (durationMs < 1) {
+		printf("Duration should be at least 1 ms\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'm':
+	  only = lock_method(optarg);
+	  if (only < 0) {
+		printf("Method should be mutex, spin, ticket, atomic, shard or padded\n");
+		exit(PGM_SYNTAX_ERROR); }
+	  break;
+
+	  case 'o':
+	  outPath = optarg;
+	  break;
+
+	  case 'v':
+	  verbose = 1;
+	  break;
+
+	  case '?':
+	  Usage(argv);
+	  exit(PGM_SYNTAX_ERROR);
+	  break;
+	} // End switch
+   } // End while
+   if (optind < argc) {
+      Usage(argv);
+      exit(PGM_SYNTAX_ERROR);
+   }
+
+   // 1, 2, 4... and the maximum itself
+   for (int t = 1; t < maxThreads; t *= 2) {
+      counts[numCounts++] = t;
+   }
+   counts[numCounts++] = maxThreads;
+
+   if (outPath != NULL) {
+      out = fopen(outPath, "w");
+      if (out == NULL) {
+         printf("Could not create %s\n", outPath);
+         exit(PGM_FILE_NOT_FOUND);
+      }
+      fprintf(out, "method,threads,ops,seconds,mops_per_sec,ns_per_op,fairness,min_max\n");
+   }
+
+   shared = aligned_alloc(CACHE_LINE_SIZE, sizeof(*shared));
+   if (shared == NULL) {
+      printf("Out of memory for the shared counters\n");
+      exit(MALLOC_ERROR);
+   }
+   memset(shared, 0, sizeof(*shared));
+   if (pthread_mutex_init(&shared->mutex, NULL) ||
+       pthread_spin_init(&shared->spin, PTHREAD_PROCESS_PRIVATE)) {
+      printf("Lock initialization failed\n");
+      exit(PGM_INTERNAL_ERROR);
+   }
+
+   printf("%d CPUs, %ld ms per measurement\n", online_cpus(), durationMs);
+   printf("%-8s %7s %12s %10s %9s %8s\n",
+          "method", "threads", "Mops/sec", "ns/op", "fairness", "min/max");
+   for (int m = 0; m < LOCK_METHODS; m++) {
+      if (only >= 0 && m != only) {
+         continue;
+      }
+      for (int c = 0; c < numCounts; c++) {
+         measure(shared, m, counts[c], durationMs, verbose, &res);
+         printf("%-8s %7d %12.3f %10.2f %9.3f %8.3f\n", methodNames[m], counts[c],
+                res.total/res.seconds/1e6, res.seconds*1e9/res.total,
+                res.fairness, res.minMax);
+         if (out != NULL) {
+            fprintf(out, "%s,%d,%ld,%.6f,%.3f,%.2f,%.4f,%.4f\n", methodNames[m],
+                    counts[c], res.total, res.seconds, res.total/res.seconds/1e6,
+                    res.seconds*1e9/res.total, res.fairness, res.minMax);
+         }
+      }
+   }
+   printf("Fairness is Jain's index of the per-thread counts, 1.0 when all got the same\n");
+
+   if (out != NULL) {
+      fclose(out);
+      printf("Results in %s\n", outPath);
+   }
+   pthread_spin_destroy(&shared->spin);
+   pthread_mutex_destroy(&shared->mutex);
+   free(shared);
+   return(PGM_SUCCESS);
+} // End main
+
+
+/****************************************************************************
+  Time one method at one thread count.  The threads start together on a
+  barrier and increment until the stop flag is raised, afterwards the
+  counter must hold exactly the sum of their increments.
+
+  void measure(struct Shared_s *shared, int method, int numThreads,
+               long durationMs, int verbose, struct Result_s *res)
+  Where: struct Shared_s *shared - the locks and counters
+         int method              - one of the LOCK_xxx values
+         int numThreads          - number of incrementing threads
+         long durationMs         - how long they run
+         int verbose             - print the per-thread counts
+         struct Result_s *res    - receives the result
+  Returns: nothing
+  Errors: exits if a thread can not be started or the count is wrong
+****************************************************************************/
+void measure(struct Shared_s *shared, int method, int numThreads, long durationMs,
+             int verbose, struct Result_s *res) {
+   struct Worker_s workers[MAX_THREADS];
+   pthread_t threads[MAX_THREADS];
+   struct timespec pause = {durationMs/1000, (durationMs % 1000)*1000000L};
+   double sum = 0.0, sumSq = 0.0;
+   long minOps, maxOps;
+   long expect;
+   int rc;
+   DECLARE_WTIMER(runTimer)
+
+   shared->processed = 0;
+   shared->ticket.next = shared->ticket.serving = 0;
+   memset(shared->shard, 0, sizeof(shared->shard));
+   memset(shared->padded, 0, sizeof(shared->padded));
+   shared->stop = 0;
+   if (pthread_barrier_init(&shared->start, NULL, numThreads + 1)) {
+      printf("Barrier initialization failed\n");
+      exit(PGM_INTERNAL_ERROR);
+   }
+
+   for (int i = 0; i < numThreads; i++) {
+      workers[i].id = i;
+      workers[i].method = method;
+      workers[i].shared = shared;
+      workers[i].ops = 0;
+      rc = pthread_create(&threads[i], NULL, worker, &workers[i]);
+      if (rc) {
+         printf("Thread failed to start rc= %d\n", rc);
+         exit(PGM_INTERNAL_ERROR);
+      }
+   }
+
+   pthread_barrier_wait(&shared->start);
+   START_NTIMER(runTimer);
+   nanosleep(&pause, NULL);
+   __atomic_store_n(&shared->stop, 1, __ATOMIC_RELAXED);
+   for (int i = 0; i < numThreads; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   STOP_NTIMER(runTimer);
+   pthread_barrier_destroy(&shared->start);
+
+   res->total = 0;
+   minOps = maxOps = workers[0].ops;
+   for (int i = 0; i < numThreads; i++) {
+      long n = workers[i].ops;
+      res->total += n;
+      sum += n;
+      sumSq += (double)n*n;
+      minOps = (n < minOps) ? n : minOps;
+      maxOps = (n > maxOps) ? n : maxOps;
+      if (verbose) {
+         printf("   %s thread %d: %ld increments\n", methodNames[method], i, n);
+      }
+   }
+   res->seconds = ELAPSED_NTIMER(runTimer);
+   res->fairness = (sumSq > 0.0) ? sum*sum/(numThreads*sumSq) : 0.0;
+   res->minMax = (maxOps > 0) ? (double)minOps/maxOps : 0.0;
+
+   expect = counter_value(shared, method, numThreads);
+   if (expect != res->total) {
+      printf("%s lost increments, counter %ld but %ld were made\n",
+             methodNames[method], expect, res->total);
+      exit(PGM_INTERNAL_ERROR);
+   }
+   if (res->total == 0) {
+      res->total = 1;   // Keeps the rates finite, nothing ran at all
+   }
+} // End measure
+
+
+/****************************************************************************
+  Increment the counter with one method until told to stop
+
+  void *worker(void *arg)
+  Where: void *arg - the struct Worker_s of this thread
+  Returns: void * - NULL
+  Errors: none
+****************************************************************************/
+void *worker(void *arg) {
+   struct Worker_s *w = arg;
+   struct Shared_s *s = w->shared;
+   long ops = 0;
+   unsigned ticket;
+
+   pthread_barrier_wait(&s->start);
+   while (!__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+      switch (w->method) {
+         case LOCK_MUTEX:
+         pthread_mutex_lock(&s->mutex);
+         s->processed++;
+         pthread_mutex_unlock(&s->mutex);
+         break;
+
+         case LOCK_SPIN:
+         pthread_spin_lock(&s->spin);
+         s->processed++;
+         pthread_spin_unlock(&s->spin);
+         break;
+
+         case LOCK_TICKET:
+         ticket = __atomic_fetch_add(&s->ticket.next, 1, __ATOMIC_RELAXED);
+         while (__atomic_load_n(&s->ticket.serving, __ATOMIC_ACQUIRE) != ticket) {
+            CPU_RELAX();
+         }
+         s->processed++;
+         __atomic_store_n(&s->ticket.serving, ticket + 1, __ATOMIC_RELEASE);
+         break;
+
+         case LOCK_ATOMIC:
+         __atomic_fetch_add(&s->processed, 1, __ATOMIC_RELAXED);
+         break;
+
+         // Only the owner writes its shard, a reader adds them up, the
+         // relaxed store keeps a concurrent reader from seeing a torn value
+         case LOCK_SHARD:
+         __atomic_store_n(&s->shard[w->id], s->shard[w->id] + 1, __ATOMIC_RELAXED);
+         break;
+
+         case LOCK_PADDED:
+         __atomic_store_n(&s->padded[w->id].count, s->padded[w->id].count + 1,
+                          __ATOMIC_RELAXED);
+         break;
+      } // End switch
+      ops++;
+   }
+   w->ops = ops;
+   return(NULL);
+} // End worker
+
+
+/****************************************************************************
+  Read the counter a method incremented
+
+  long counter_value(struct Shared_s *shared, int method, int numThreads)
+  Where: struct Shared_s *shared - the locks and counters
+         int method              - one of the LOCK_xxx values
+         int numThreads          - number of threads that ran
+  Returns: long - the shared counter, or the sum of the shards
+  Errors: none
+****************************************************************************/
+long counter_value(struct Shared_s *shared, int method, int numThreads) {
+   long total = 0;
+
+   if (method == LOCK_SHARD) {
+      for (int i = 0; i < numThreads; i++) {
+         total += shared->shard[i];
+      }
+      return(total);
+   }
+   if (method == LOCK_PADDED) {
+      for (int i = 0; i < numThreads; i++) {
+         total += shared->padded[i].count;
+      }
+      return(total);
+   }
+   return(shared->processed);
+} // End counter_value
+
+
+/****************************************************************************
+  Convert a method name to its LOCK_xxx value
+
+  int lock_method(const char *name)
+  Where: const char *name - mutex, spin, ticket, atomic, shard or padded
+  Returns: int - the LOCK_xxx value, -1 if unknown
+  Errors: none
+****************************************************************************/
+int lock_method(const char *name) {
+   for (int i = 0; i < LOCK_METHODS; i++) {
+      if (strcmp(name, methodNames[i]) == 0) {
+         return(i);
+      }
+   }
+   return(-1);
+} // End lock_method
+
+
+/****************************************************************************
+  Count the CPUs this process may run on, as in hw13
+
+  int online_cpus(void)
+  Returns: int - number of usable CPUs, at least 1
+  Errors: none
+****************************************************************************/
+int online_cpus(void) {
+   cpu_set_t set;
+   int n = 0;
+
+   if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      n = CPU_COUNT(&set);
+   }
+   if (n < 1) {
+      n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   n = (n < 1) ? 1 : n;
+   return((n > MAX_THREADS) ? MAX_THREADS : n);
+} // End online_cpus
+
+
+/****************************************************************************
+  Print the program usage
+
+  void Usage(char *argv[])
+  Where: char *argv[] - the program arguments
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void Usage(char *argv[]) {
+   fprintf(stderr, "\nIncrement a shared counter under different synchronization schemes.\n");
+   fprintf(stderr, "usage: %s [-t[hreads] num] [-d[uration] ms] [-m[ethod] name]\n", argv[0]);
+   fprintf(stderr, "            [-o[ut] file] [-v[erbose]]\n");
+   fprintf(stderr, "Where: -t[hreads] num  - largest thread count, runs 1, 2, 4... up to\n");
+   fprintf(stderr, "                         it, optional, default one per CPU (%d)\n", online_cpus());
+   fprintf(stderr, "       -d[uration] ms  - time per measurement, optional, default %d\n",
+                   DEFAULT_DURATION_MS);
+   fprintf(stderr, "       -m[ethod] name  - mutex, spin, ticket, atomic, shard (per-thread\n");
+   fprintf(stderr, "                         counters in one array) or padded (one per\n");
+   fprintf(stderr, "                         cache line), optional, default all\n");
+   fprintf(stderr, "       -o[ut] file     - also write the results as CSV, optional\n");
+   fprintf(stderr, "       -v[erbose]      - print the per-thread counts, optional\n");
+   fprintf(stderr, "eg: %s -t 8 -d 500\n", argv[0]);
+} // End Usage
@@ -0,0 +1,240 @@
+//  Data buffer allocation for hw13
+//
+//  None of the modes touches the memory, so the first write to each page
+//  happens in the prefault pass or in the fill itself.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mem.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+static const char *modeNames[] = {"malloc", "mmap", "thp", "huge", "file"};
+#define NUM_MODES ((int)(sizeof(modeNames)/sizeof(modeNames[0])))
+
+// Round up to a multiple of a power of two
+#define ROUND_UP(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+
+/****************************************************************************
+  Allocate a data buffer
+
+  int bufAlloc(struct Buffer_s *buf, size_t bytes, int mode)
+  Where: struct Buffer_s *buf - receives the buffer description
+         size_t bytes         - number of bytes needed
+         int mode             - one of the MEM_xxx values
+  Returns: int - 0 on success, -1 if even the fallback failed
+  Errors: none
+****************************************************************************/
+int bufAlloc(struct Buffer_s *buf, size_t bytes, int mode) {
+   size_t page = (size_t)sysconf(_SC_PAGESIZE);
+   void *p;
+
+   memset(buf, 0, sizeof(*buf));
+   buf->bytes = bytes;
+   buf->pageSize = page;
+   buf->touchSize = page;
+   buf->fd = -1;
+
+#ifdef MAP_HUGETLB
+   if (mode == MEM_HUGE) {
+      buf->mapped = ROUND_UP(bytes, HUGE_PAGE_SIZE);
+      p = mmap(NULL, buf->mapped, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) {
+         buf->ptr = buf->base = p;
+         buf->mode = MEM_HUGE;
+         buf->pageSize = HUGE_PAGE_SIZE;
+         buf->touchSize = HUGE_PAGE_SIZE;
+         return(0);
+      }
+   }
+#endif
+   if (mode == MEM_HUGE || mode == MEM_THP) {
+      // Over-allocate so the data can start on a huge page boundary
+      buf->mapped = ROUND_UP(bytes, HUGE_PAGE_SIZE) + HUGE_PAGE_SIZE;
+      p = mmap(NULL, buf->mapped, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p != MAP_FAILED) {
+         buf->base = p;
+         buf->ptr = (void *)ROUND_UP((uintptr_t)p, HUGE_PAGE_SIZE);
+         buf->mode = MEM_THP;
+#ifdef MADV_HUGEPAGE
+         // Only a hint, the kernel may still back any part with base
+         // pages, so touchSize stays at the base page
+         if (madvise(buf->ptr, ROUND_UP(bytes, HUGE_PAGE_SIZE), MADV_HUGEPAGE) == 0) {
+            buf->pageSize = HUGE_PAGE_SIZE;
+         }
+#endif
+         return(0);
+      }
+   }
+   if (mode != MEM_MALLOC) {
+      buf->mapped = ROUND_UP(bytes, page);
+      p = mmap(NULL, buf->mapped, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) {
+         return(-1);
+      }
+      buf->ptr = buf->base = p;
+      buf->mode = MEM_MMAP;
+      return(0);
+   }
+
+   buf->mapped = 0;
+   buf->ptr = buf->base = malloc(bytes);
+   buf->mode = MEM_MALLOC;
+   return((buf->ptr == NULL) ? -1 : 0);
+} // End bufAlloc
+
+
+/****************************************************************************
+  Map a file as the data buffer.  The file is created if needed and set to
+  the buffer size without writing it, so it starts out sparse and only the
+  pages the fill writes take disk space.
+
+  int bufMapFile(struct Buffer_s *buf, size_t bytes, const char *path)
+  Where: struct Buffer_s *buf - receives the buffer description
+         size_t bytes         - number of bytes needed
+         const char *path     - the file, existing contents are overwritten
+  Returns: int - 0 on success, -1 with errno set on failure
+  Errors: none
+****************************************************************************/
+int bufMapFile(struct Buffer_s *buf, size_t bytes, const char *path) {
+   void *p;
+   int err;
+
+   memset(buf, 0, sizeof(*buf));
+   buf->bytes = bytes;
+   buf->pageSize = (size_t)sysconf(_SC_PAGESIZE);
+   buf->touchSize = buf->pageSize;
+   buf->mapped = ROUND_UP(bytes, buf->pageSize);
+   buf->fd = open(path, O_RDWR | O_CREAT, 0644);
+   if (buf->fd < 0) {
+      return(-1);
+   }
+   if (ftruncate(buf->fd, (off_t)bytes)) {
+      err = errno;
+      close(buf->fd);
+      buf->fd = -1;
+      errno = err;
+      return(-1);
+   }
+   p = mmap(NULL, buf->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, buf->fd, 0);
+   if (p == MAP_FAILED) {
+      err = errno;
+      close(buf->fd);
+      buf->fd = -1;
+      errno = err;
+      return(-1);
+   }
+   buf->ptr = buf->base = p;
+   buf->mode = MEM_FILE;
+   return(0);
+} // End bufMapFile
+
+
+/****************************************************************************
+  Start writing back a finished part of a file buffer.  Does not wait for
+  the disk, it only keeps dirty pages from piling up so a buffer larger
+  than RAM streams out while the fill goes on.  Nothing happens for the
+  other modes.
+
+  int bufSync(struct Buffer_s *buf, size_t offset, size_t len)
+  Where: struct Buffer_s *buf - the buffer
+         size_t offset        - byte offset of the finished part
+         size_t len           - its length in bytes
+  Returns: int - 0 on success, -1 with errno set on failure
+  Errors: none
+****************************************************************************/
+int bufSync(struct Buffer_s *buf, size_t offset, size_t len) {
+   if (buf->mode != MEM_FILE) {
+      return(0);
+   }
+#ifdef SYNC_FILE_RANGE_WRITE
+   return(sync_file_range(buf->fd, (off_t)offset, (off_t)len, SYNC_FILE_RANGE_WRITE));
+#else
+   // msync() needs a page aligned start
+   size_t start = offset & ~(buf->pageSize - 1);
+   return(msync((char *)buf->base + start, offset + len - start, MS_ASYNC));
+#endif
+} // End bufSync
+
+
+/****************************************************************************
+  Wait until all of a file buffer is on disk, nothing happens for the other
+  modes
+
+  int bufFlush(struct Buffer_s *buf)
+  Where: struct Buffer_s *buf - the buffer
+  Returns: int - 0 on success, -1 with errno set on failure
+  Errors: none
+****************************************************************************/
+int bufFlush(struct Buffer_s *buf) {
+   if (buf->mode != MEM_FILE) {
+      return(0);
+   }
+   return(msync(buf->base, buf->mapped, MS_SYNC));
+} // End bufFlush
+
+
+/****************************************************************************
+  Release a data buffer
+
+  void bufFree(struct Buffer_s *buf)
+  Where: struct Buffer_s *buf - the buffer, nothing happens if not allocated
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void bufFree(struct Buffer_s *buf) {
+   if (buf->base == NULL) {
+      return;
+   }
+   if (buf->mode == MEM_MALLOC) {
+      free(buf->base);
+   }
+   else {
+      munmap(buf->base, buf->mapped);
+   }
+   if (buf->fd >= 0) {
+      close(buf->fd);
+      buf->fd = -1;
+   }
+   buf->ptr = buf->base = NULL;
+} // End bufFree
+
+
+/****************************************************************************
+  Convert between allocation mode names and values
+
+  int bufMode(const char *name)
+  Where: const char *name - malloc, mmap, thp, huge or file
+  Returns: int - the MEM_xxx value, -1 if unknown
+
+  const char *bufName(int mode)
+  Where: int mode - one of the MEM_xxx values
+  Returns: const char * - the mode name
+****************************************************************************/
+int bufMode(const char *name) {
+   for (int i = 0; i < NUM_MODES; i++) {
+      if (strcmp(name, modeNames[i]) == 0) {
+         return(i);
+      }
+   }
+   return(-1);
+} // End bufMode
+
+const char *bufName(int mode) {
+   if (mode < 0 || mode >= NUM_MODES) {
+      return("unknown");
+   }
+   return(modeNames[mode]);
+} // End bufName
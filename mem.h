@@ -0,0 +1,53 @@
+/******************************************************************************
+* Data buffer allocation for hw13
+*
+* Allocation modes:
+*   malloc - plain malloc(), the original behavior
+*   mmap   - anonymous private mapping with normal pages
+*   thp    - anonymous mapping aligned to the huge page size and marked with
+*            madvise(MADV_HUGEPAGE) so transparent huge pages back it
+*   huge   - MAP_HUGETLB mapping from the reserved huge page pool
+*   file   - shared mapping of a sparse file (bufMapFile), the data goes
+*            straight to the file so it may be larger than RAM and is
+*            still there after the run
+* A mode that can not be satisfied falls back to the next simpler one
+* (huge -> thp -> mmap), the buffer records the mode actually used.
+******************************************************************************/
+#ifndef _MEM_H_
+#define _MEM_H_
+
+#include <stddef.h>
+
+/* Allocation modes */
+#define MEM_MALLOC          (0)
+#define MEM_MMAP            (1)
+#define MEM_THP             (2)
+#define MEM_HUGE            (3)
+#define MEM_FILE            (4)
+
+/* Huge page size assumed for alignment and MAP_HUGETLB rounding */
+#define HUGE_PAGE_SIZE      (2*1024*1024)
+
+/* One allocated data buffer */
+struct Buffer_s {
+   void *ptr;           // Start of the usable data
+   size_t bytes;        // Requested size
+   size_t mapped;       // Size of the mapping, 0 for malloc
+   void *base;          // Start of the mapping, may be below ptr
+   int mode;            // MEM_xxx mode actually used
+   size_t pageSize;     // Page size backing the buffer (best guess for thp)
+   size_t touchSize;    // Stride that faults in every page, huge only for
+                        // MAP_HUGETLB where it is guaranteed
+   int fd;              // The backing file for MEM_FILE, -1 otherwise
+};
+
+/* Function prototypes */
+int bufAlloc(struct Buffer_s *buf, size_t bytes, int mode);
+int bufMapFile(struct Buffer_s *buf, size_t bytes, const char *path);
+int bufSync(struct Buffer_s *buf, size_t offset, size_t len);
+int bufFlush(struct Buffer_s *buf);
+void bufFree(struct Buffer_s *buf);
+int bufMode(const char *name);
+const char *bufName(int mode);
+
+#endif /* _MEM_H_ */
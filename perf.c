@@ -0,0 +1,157 @@
+//  Hardware performance counters for the hw13 workers
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Cache event config: cache id, operation and result, one byte each
+#define CACHE_EVENT(c, op, res) ((c) | ((op) << 8) | ((res) << 16))
+
+// Event type and config, the second config is tried if the first fails
+static const struct {
+   uint32_t type;
+   uint64_t config[2];
+} events[PERF_EVENTS] = {
+   {PERF_TYPE_HARDWARE, {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CPU_CYCLES}},
+   {PERF_TYPE_HARDWARE, {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_INSTRUCTIONS}},
+   {PERF_TYPE_HARDWARE, {PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_CACHE_MISSES}},
+   // The fill stores, so store misses first, load misses on CPUs without them
+   {PERF_TYPE_HW_CACHE, {CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE,
+                                     PERF_COUNT_HW_CACHE_RESULT_MISS),
+                         CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                     PERF_COUNT_HW_CACHE_RESULT_MISS)}},
+   {PERF_TYPE_SOFTWARE, {PERF_COUNT_SW_PAGE_FAULTS, PERF_COUNT_SW_PAGE_FAULTS}},
+};
+
+// Layout of read() with the time enabled and running formats
+struct ReadValue_s {
+   uint64_t value;
+   uint64_t enabled;
+   uint64_t running;
+};
+
+
+/****************************************************************************
+  Open the counters for the calling thread, all disabled
+
+  int perfOpen(struct Perf_s *perf)
+  Where: struct Perf_s *perf - receives the counters
+  Returns: int - number of events that could be opened, 0 if none
+  Errors: none, refused events are silently left out
+****************************************************************************/
+int perfOpen(struct Perf_s *perf) {
+   struct perf_event_attr attr;
+   int opened = 0;
+
+   for (int e = 0; e < PERF_EVENTS; e++) {
+      perf->fd[e] = -1;
+      perf->value[e] = 0;
+      for (int c = 0; c < 2 && perf->fd[e] < 0; c++) {
+         memset(&attr, 0, sizeof(attr));
+         attr.size = sizeof(attr);
+         attr.type = events[e].type;
+         attr.config = events[e].config[c];
+         attr.disabled = 1;
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+         attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING;
+         perf->fd[e] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      }
+      perf->valid[e] = (perf->fd[e] >= 0);
+      opened += perf->valid[e];
+   }
+   return(opened);
+} // End perfOpen
+
+
+/****************************************************************************
+  Zero and start the counters
+
+  void perfStart(struct Perf_s *perf)
+  Where: struct Perf_s *perf - the counters
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void perfStart(struct Perf_s *perf) {
+   for (int e = 0; e < PERF_EVENTS; e++) {
+      if (perf->fd[e] >= 0) {
+         ioctl(perf->fd[e], PERF_EVENT_IOC_RESET, 0);
+         ioctl(perf->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+      }
+   }
+} // End perfStart
+
+
+/****************************************************************************
+  Stop the counters and read them into perf->value.  Counts of events that
+  had to share the PMU are scaled up to the whole enabled time.
+
+  void perfStop(struct Perf_s *perf)
+  Where: struct Perf_s *perf - the counters
+  Returns: nothing
+  Errors: an event that can not be read is marked invalid
+****************************************************************************/
+void perfStop(struct Perf_s *perf) {
+   struct ReadValue_s rv;
+
+   for (int e = 0; e < PERF_EVENTS; e++) {
+      if (perf->fd[e] < 0) {
+         continue;
+      }
+      ioctl(perf->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(perf->fd[e], &rv, sizeof(rv)) != sizeof(rv)) {
+         close(perf->fd[e]);
+         perf->fd[e] = -1;
+         perf->valid[e] = 0;
+         continue;
+      }
+      if (rv.running > 0 && rv.running < rv.enabled) {
+         perf->value[e] = (long long)((double)rv.value*rv.enabled/rv.running);
+      }
+      else {
+         perf->value[e] = (long long)rv.value;
+      }
+   } // End for events
+} // End perfStop
+
+
+/****************************************************************************
+  Close the counters, the last values stay readable
+
+  void perfClose(struct Perf_s *perf)
+  Where: struct Perf_s *perf - the counters
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void perfClose(struct Perf_s *perf) {
+   for (int e = 0; e < PERF_EVENTS; e++) {
+      if (perf->fd[e] >= 0) {
+         close(perf->fd[e]);
+         perf->fd[e] = -1;
+      }
+   }
+} // End perfClose
+
+
+/****************************************************************************
+  Check whether an event was counted
+
+  int perfValid(const struct Perf_s *perf, int event)
+  Where: const struct Perf_s *perf - the counters
+         int event                 - one of the PERF_xxx events
+  Returns: int - 1 if the event was counted, 0 if not available
+  Errors: none
+****************************************************************************/
+int perfValid(const struct Perf_s *perf, int event) {
+   return(perf->valid[event]);
+} // End perfValid
@@ -0,0 +1,36 @@
+/******************************************************************************
+* Hardware performance counters for the hw13 workers
+*
+* Each worker opens its own counters with perf_event_open() on its own
+* thread (pid 0, any cpu) so the counts follow the thread wherever it runs.
+* Only user space is counted, which perf_event_paranoid 2 still allows.
+* Every event is opened on its own, an event the kernel or the CPU refuses
+* (virtual machines often have no PMU, containers may block the syscall) is
+* just marked invalid and the rest still count.
+******************************************************************************/
+#ifndef _PERF_H_
+#define _PERF_H_
+
+/* Counted events */
+#define PERF_CYCLES         (0)
+#define PERF_INSTRUCTIONS   (1)
+#define PERF_LLC_MISSES     (2)
+#define PERF_DTLB_MISSES    (3)
+#define PERF_PAGE_FAULTS    (4)
+#define PERF_EVENTS         (5)
+
+/* The counters of one thread */
+struct Perf_s {
+   int fd[PERF_EVENTS];             // -1 if not open
+   int valid[PERF_EVENTS];          // 1 if the event could be counted
+   long long value[PERF_EVENTS];    // Counts of the last perfStart/perfStop
+};
+
+/* Function prototypes */
+int perfOpen(struct Perf_s *perf);
+void perfStart(struct Perf_s *perf);
+void perfStop(struct Perf_s *perf);
+void perfClose(struct Perf_s *perf);
+int perfValid(const struct Perf_s *perf, int event);
+
+#endif /* _PERF_H_ */
@@ -0,0 +1,408 @@
+//  Pipelined generate -> consume mode for hw13
+//
+//  The generators run on the caller's pool, the consumers on a pool of
+//  their own created for the run, so both stages are busy at the same time.
+//  A thread that finds its ring empty spins briefly and then yields the CPU,
+//  which keeps an oversubscribed machine moving.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include "engine.h"
+#include "scan.h"
+#include "pipe.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Empty polls before a waiting thread yields the CPU
+#define SPIN_LIMIT          (64)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX()         __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+// One chunk buffer
+struct Chunk_s {
+   long begin;                // Index of the first element
+   long count;                // Elements in use
+   elem_t *data;              // Cache line aligned, chunk elements long
+};
+
+// Ring cell, seq == position when free to push, position + 1 when full
+struct Cell_s {
+   size_t seq;
+   struct Chunk_s *chunk;
+};
+
+// Bounded MPMC ring, the two cursors on lines of their own
+struct Ring_s {
+   struct Cell_s *cells;
+   size_t mask;               // Number of cells - 1, a power of two
+   size_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // Next push
+   size_t head __attribute__((aligned(CACHE_LINE_SIZE))); // Next pop
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// State shared by both stages of one run
+struct Pipe_s {
+   struct Ring_s full;        // Filled chunks for the consumers
+   struct Ring_s free;        // Empty buffers for the generators
+   const struct Gen_s *gen;
+   FillFn_t fill;
+   VerifyFn_t verify;
+   long count;                // Elements in the run
+   long chunk;                // Elements per chunk
+   int outFd;                 // Written at the element offsets, -1 if not
+   long next __attribute__((aligned(CACHE_LINE_SIZE))); // Generator cursor
+   int producersLeft __attribute__((aligned(CACHE_LINE_SIZE)));
+   int stop;                  // Set when a stage failed to start
+   long firstError __attribute__((aligned(CACHE_LINE_SIZE)));
+   int writeError;
+};
+
+// Per-thread argument and counts
+struct Stage_s {
+   struct Pipe_s *pipe;
+   long chunks;               // Chunks handled by this thread
+   uelem_t sum;               // Consumers, sum of their chunks
+   long waits;                // Empty ring polls that yielded
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+static int ringInit(struct Ring_s *ring, int slots);
+static int ringPush(struct Ring_s *ring, struct Chunk_s *chunk);
+static int ringPop(struct Ring_s *ring, struct Chunk_s **chunk);
+static void *produce(void *data);
+static void *consume(void *data);
+static void consumeChunk(struct Stage_s *st, struct Chunk_s *c);
+
+
+/****************************************************************************
+  Run the pipeline over count elements and wait for it to drain
+
+  int pipeRun(struct Pool_s *pool, int numProducers, int numConsumers,
+              int slots, long count, long chunk, const struct Gen_s *gen,
+              int kernel, int outFd, struct PipeResult_s *res)
+  Where: struct Pool_s *pool      - workers for the generators
+         int numProducers         - generators, at most the pool size
+         int numConsumers         - consumer threads to create
+         int slots                - chunk buffers, 0 for
+                                    PIPE_SLOTS_PER_THREAD per thread
+         long count               - number of elements
+         long chunk               - elements per chunk
+         const struct Gen_s *gen  - generator of the element values
+         int kernel               - fill kernel, not KERNEL_AUTO
+         int outFd                - file to write the elements to at their
+                                    own offsets, -1 for none
+         struct PipeResult_s *res - receives the counts and checks
+  Returns: int - 0 on success, -1 if the buffers or threads could not be
+                 set up
+  Errors: none
+****************************************************************************/
+int pipeRun(struct Pool_s *pool, int numProducers, int numConsumers, int slots,
+            long count, long chunk, const struct Gen_s *gen, int kernel, int outFd,
+            struct PipeResult_s *res) {
+   struct Pipe_s *p;
+   struct Stage_s *stages;
+   struct Chunk_s *chunks;
+   struct Pool_s *consumers;
+   int numStages = numProducers + numConsumers;
+   int rc = 0;
+
+   if (slots <= 0) {
+      slots = PIPE_SLOTS_PER_THREAD*numStages;
+   }
+   // More buffers than chunks would never be used
+   if ((long)slots > (count + chunk - 1)/chunk) {
+      slots = (int)((count + chunk - 1)/chunk);
+   }
+   if (posix_memalign((void **)&p, CACHE_LINE_SIZE, sizeof(*p))) {
+      return(-1);
+   }
+   memset(p, 0, sizeof(*p));
+   if (posix_memalign((void **)&stages, CACHE_LINE_SIZE, numStages*sizeof(*stages))) {
+      free(p);
+      return(-1);
+   }
+   memset(stages, 0, numStages*sizeof(*stages));
+   chunks = calloc(slots, sizeof(*chunks));
+   consumers = poolCreate(numConsumers);
+   if (chunks == NULL || consumers == NULL || ringInit(&p->full, slots) ||
+       ringInit(&p->free, slots)) {
+      poolDestroy(consumers);
+      free(chunks);
+      free(p->full.cells);
+      free(p->free.cells);
+      free(stages);
+      free(p);
+      return(-1);
+   }
+   p->gen = gen;
+   p->fill = fillFunc(kernel);
+   p->verify = verifyFunc(kernel);
+   p->count = count;
+   p->chunk = chunk;
+   p->outFd = outFd;
+   p->producersLeft = numProducers;
+   p->firstError = count;
+
+   // Every buffer starts out free
+   for (int i = 0; i < slots; i++) {
+      if (posix_memalign((void **)&chunks[i].data, CACHE_LINE_SIZE, chunk*sizeof(elem_t))) {
+         slots = i;
+         break;
+      }
+      ringPush(&p->free, &chunks[i]);
+   }
+
+   for (int i = 0; i < numStages; i++) {
+      stages[i].pipe = p;
+   }
+   // Without a single buffer the generators could never start.  A stage
+   // that did not start would leave the others waiting on the rings, so
+   // they are stopped and the run fails, joining an idle worker is a no-op.
+   for (int i = 0; slots > 0 && i < numConsumers; i++) {
+      rc |= poolStart(consumers, i, consume, &stages[numProducers + i]);
+   }
+   for (int i = 0; slots > 0 && rc == 0 && i < numProducers; i++) {
+      rc |= poolStart(pool, i, produce, &stages[i]);
+   }
+   if (rc) {
+      __atomic_store_n(&p->stop, 1, __ATOMIC_RELAXED);
+   }
+   for (int i = 0; slots > 0 && i < numProducers; i++) {
+      poolJoin(pool, i, NULL);
+   }
+   for (int i = 0; slots > 0 && i < numConsumers; i++) {
+      poolJoin(consumers, i, NULL);
+   }
+   poolDestroy(consumers);
+
+   memset(res, 0, sizeof(*res));
+   for (int i = 0; i < numProducers; i++) {
+      res->produceWaits += stages[i].waits;
+   }
+   for (int i = numProducers; i < numStages; i++) {
+      res->chunks += stages[i].chunks;
+      res->sum += stages[i].sum;
+      res->consumeWaits += stages[i].waits;
+   }
+   res->firstError = p->firstError;
+   res->writeError = p->writeError;
+   res->slots = slots;
+
+   for (int i = 0; i < slots; i++) {
+      free(chunks[i].data);
+   }
+   free(chunks);
+   free(p->full.cells);
+   free(p->free.cells);
+   free(stages);
+   free(p);
+   return((slots > 0 && rc == 0) ? 0 : -1);
+} // End pipeRun
+
+
+/****************************************************************************
+  Generator stage: take the next chunk index, fill a free buffer and pass
+  it on, until all the elements are handed out
+****************************************************************************/
+static void *produce(void *data) {
+   struct Stage_s *st = data;
+   struct Pipe_s *p = st->pipe;
+   struct Chunk_s *c;
+   long begin;
+
+   while ((begin = __atomic_fetch_add(&p->next, p->chunk, __ATOMIC_RELAXED)) < p->count) {
+      for (int spins = 0; ringPop(&p->free, &c); ) {
+         if (__atomic_load_n(&p->stop, __ATOMIC_RELAXED)) {
+            return(NULL);
+         }
+         if (++spins < SPIN_LIMIT) {
+            CPU_RELAX();
+            continue;
+         }
+         st->waits++;
+         spins = 0;
+         sched_yield();
+      }
+      c->begin = begin;
+      c->count = (begin + p->chunk < p->count) ? p->chunk : p->count - begin;
+      engineRange(p->gen, p->fill, c->data, c->begin, c->count);
+      ringPush(&p->full, c);
+      st->chunks++;
+   }
+   // The last push is visible to a consumer that sees the count drop
+   __atomic_sub_fetch(&p->producersLeft, 1, __ATOMIC_RELEASE);
+   return(NULL);
+} // End produce
+
+
+/****************************************************************************
+  Consumer stage: handle full chunks until the generators are done and the
+  ring is empty
+****************************************************************************/
+static void *consume(void *data) {
+   struct Stage_s *st = data;
+   struct Pipe_s *p = st->pipe;
+   struct Chunk_s *c;
+   int spins = 0;
+
+   for (;;) {
+      if (ringPop(&p->full, &c) == 0) {
+         consumeChunk(st, c);
+         ringPush(&p->free, c);
+         spins = 0;
+         continue;
+      }
+      if (__atomic_load_n(&p->producersLeft, __ATOMIC_ACQUIRE) == 0) {
+         // Everything was pushed before the count dropped, one last look
+         if (ringPop(&p->full, &c) == 0) {
+            consumeChunk(st, c);
+            ringPush(&p->free, c);
+            continue;
+         }
+         break;
+      }
+      if (__atomic_load_n(&p->stop, __ATOMIC_RELAXED)) {
+         break;
+      }
+      if (++spins < SPIN_LIMIT) {
+         CPU_RELAX();
+         continue;
+      }
+      st->waits++;
+      spins = 0;
+      sched_yield();
+   } // End for ever
+   return(NULL);
+} // End consume
+
+
+/****************************************************************************
+  Verify, sum and write out one chunk
+****************************************************************************/
+static void consumeChunk(struct Stage_s *st, struct Chunk_s *c) {
+   struct Pipe_s *p = st->pipe;
+   long off = engineCheck(p->gen, p->verify, c->data, c->begin, c->count);
+
+   // Keep the lowest mismatch of all the consumers
+   if (off < c->count) {
+      long bad = c->begin + off;
+      long cur = __atomic_load_n(&p->firstError, __ATOMIC_RELAXED);
+      while (bad < cur && !__atomic_compare_exchange_n(&p->firstError, &cur, bad, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      }
+   }
+   st->sum += scanSum(c->data, c->count);
+
+   if (p->outFd >= 0 && __atomic_load_n(&p->writeError, __ATOMIC_RELAXED) == 0) {
+      const char *src = (const char *)c->data;
+      size_t left = c->count*sizeof(elem_t);
+      off_t pos = (off_t)c->begin*sizeof(elem_t);
+      while (left > 0) {
+         ssize_t n = pwrite(p->outFd, src, left, pos);
+         if (n < 0 && errno == EINTR) {
+            continue;
+         }
+         if (n <= 0) {
+            __atomic_store_n(&p->writeError, (n < 0) ? errno : EIO, __ATOMIC_RELAXED);
+            break;
+         }
+         src += n;
+         left -= n;
+         pos += n;
+      }
+   }
+   st->chunks++;
+} // End consumeChunk
+
+
+/****************************************************************************
+  Set up an empty ring with room for at least slots chunks
+****************************************************************************/
+static int ringInit(struct Ring_s *ring, int slots) {
+   size_t size = 1;
+
+   while (size < (size_t)slots) {
+      size *= 2;
+   }
+   ring->cells = malloc(size*sizeof(*ring->cells));
+   if (ring->cells == NULL) {
+      return(-1);
+   }
+   for (size_t i = 0; i < size; i++) {
+      ring->cells[i].seq = i;
+   }
+   ring->mask = size - 1;
+   ring->head = ring->tail = 0;
+   return(0);
+} // End ringInit
+
+
+/****************************************************************************
+  Add a chunk to a ring, returns -1 if it is full
+****************************************************************************/
+static int ringPush(struct Ring_s *ring, struct Chunk_s *chunk) {
+   size_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+   struct Cell_s *cell;
+
+   for (;;) {
+      cell = &ring->cells[pos & ring->mask];
+      size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      long diff = (long)(seq - pos);
+      if (diff == 0) {
+         // The cell is free, claim the position
+         if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+         }
+      }
+      else if (diff < 0) {
+         return(-1);
+      }
+      else {
+         pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+      }
+   } // End for ever
+   cell->chunk = chunk;
+   __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+   return(0);
+} // End ringPush
+
+
+/****************************************************************************
+  Take the oldest chunk from a ring, returns -1 if it is empty
+****************************************************************************/
+static int ringPop(struct Ring_s *ring, struct Chunk_s **chunk) {
+   size_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+   struct Cell_s *cell;
+
+   for (;;) {
+      cell = &ring->cells[pos & ring->mask];
+      size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      long diff = (long)(seq - (pos + 1));
+      if (diff == 0) {
+         // The cell is full, claim the position
+         if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+         }
+      }
+      else if (diff < 0) {
+         return(-1);
+      }
+      else {
+         pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+      }
+   } // End for ever
+   *chunk = cell->chunk;
+   // Free again for the push one lap later
+   __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+   return(0);
+} // End ringPop
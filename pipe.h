@@ -0,0 +1,43 @@
+/******************************************************************************
+* Pipelined generate -> consume mode for hw13
+*
+* Instead of filling one array and verifying it afterwards, the generator
+* workers fill small chunk buffers and publish them in a bounded lock-free
+* ring while a separate pool of consumer threads verifies, checksums and
+* optionally writes out every chunk as it arrives.  Emptied buffers go back
+* to the generators through a second ring, so only slots*chunk elements are
+* ever resident however large the run is.
+*
+* Both rings are Vyukov bounded MPMC queues: an array of cells each with a
+* sequence number, producers and consumers claim a position with a CAS on
+* their own cursor and the cell sequence tells whether it is ready.  A push
+* can never find a ring full because each holds at most the slots buffers
+* there are, so only an empty ring makes a thread wait.
+******************************************************************************/
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+#include "pool.h"
+#include "fill.h"
+#include "gen.h"
+
+/* Ring slots per thread when none are given */
+#define PIPE_SLOTS_PER_THREAD  (2)
+
+/* What a pipeline run did */
+struct PipeResult_s {
+   long chunks;               // Chunks that went through the ring
+   uelem_t sum;               // Wrapping sum of all the elements
+   long firstError;           // Lowest mismatching index, count if none
+   int writeError;            // errno of a failed write, 0 if none
+   long produceWaits;         // Times a generator found no free buffer
+   long consumeWaits;         // Times a consumer found no full chunk
+   int slots;                 // Chunk buffers actually used
+};
+
+/* Function prototypes */
+int pipeRun(struct Pool_s *pool, int numProducers, int numConsumers, int slots,
+            long count, long chunk, const struct Gen_s *gen, int kernel, int outFd,
+            struct PipeResult_s *res);
+
+#endif /* _PIPE_H_ */
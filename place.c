@@ -0,0 +1,314 @@
+//  CPU affinity and NUMA placement of the hw13 workers
+//
+//  Everything here is best effort, a missing sysfs file only loses
+//  information (single node, one core per CPU) and never fails the run.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "place.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+#define SYSFS_NODE  "/sys/devices/system/node"
+#define SYSFS_CPU   "/sys/devices/system/cpu"
+
+// Largest CPU number handled, matches the glibc cpu_set_t
+#define MAX_CPUS    (CPU_SETSIZE)
+
+// One usable CPU and where it lives
+struct CpuInfo_s {
+   int cpu;          // CPU number
+   int node;         // NUMA node, 0 on a single node machine
+   int core;         // Lowest sibling, identifies the physical core
+   int smt;          // 0 for the first thread of a core, 1 for the next...
+};
+
+static int parseList(const char *list, char *set, int max, int *seq);
+static int readList(const char *path, char *set, int max);
+static int readTopology(struct CpuInfo_s *info);
+
+
+/****************************************************************************
+  Convert a placement spec to a policy
+
+  int placeAffinity(const char *spec)
+  Where: const char *spec - none, compact, scatter or a cpu list
+  Returns: int - the AFFINITY_xxx value, -1 if the spec is not valid
+  Errors: none
+****************************************************************************/
+int placeAffinity(const char *spec) {
+   char set[MAX_CPUS];
+
+   if (strcmp(spec, "none") == 0) {
+      return(AFFINITY_NONE);
+   }
+   if (strcmp(spec, "compact") == 0) {
+      return(AFFINITY_COMPACT);
+   }
+   if (strcmp(spec, "scatter") == 0) {
+      return(AFFINITY_SCATTER);
+   }
+   if (parseList(spec, set, MAX_CPUS, NULL) > 0) {
+      return(AFFINITY_LIST);
+   }
+   return(-1);
+} // End placeAffinity
+
+
+/****************************************************************************
+  Decide on which CPU each worker runs and on which node its memory lives
+
+  int placeWorkers(const char *spec, int numThreads, int *cpu, int *node)
+  Where: const char *spec - none, compact, scatter or a cpu list
+         int numThreads   - number of workers
+         int *cpu         - receives the CPU of each worker, -1 if not pinned
+         int *node        - receives the NUMA node of each worker
+  Returns: int - 0 on success, -1 if the spec is not valid or names no CPU
+                 this process may use
+  Errors: none
+****************************************************************************/
+int placeWorkers(const char *spec, int numThreads, int *cpu, int *node) {
+   struct CpuInfo_s *info, *order;
+   char set[MAX_CPUS];
+   int seq[MAX_CPUS];
+   int policy = placeAffinity(spec);
+   int numCpus, numSeq, n = 0;
+
+   if (policy < 0) {
+      return(-1);
+   }
+   info = malloc(2*MAX_CPUS*sizeof(*info));
+   if (info == NULL) {
+      return(-1);
+   }
+   order = &info[MAX_CPUS];
+   numCpus = readTopology(info);
+
+   switch (policy) {
+      case AFFINITY_NONE:
+      for (int i = 0; i < numThreads; i++) {
+         cpu[i] = -1;
+         node[i] = 0;
+      }
+      free(info);
+      return(0);
+
+      case AFFINITY_LIST:
+      // Keep the list order, dropping CPUs the process may not use
+      numSeq = parseList(spec, set, MAX_CPUS, seq);
+      for (int i = 0; i < numSeq; i++) {
+         for (int j = 0; j < numCpus; j++) {
+            if (info[j].cpu == seq[i]) {
+               order[n++] = info[j];
+            }
+         }
+      } // End for list
+      break;
+
+      case AFFINITY_COMPACT:
+      // Node by node, core by core, siblings adjacent
+      for (int nd = 0; n < numCpus && nd < MAX_CPUS; nd++) {
+         for (int j = 0; j < numCpus; j++) {
+            if (info[j].node != nd || info[j].smt != 0) {
+               continue;
+            }
+            for (int k = 0; k < numCpus; k++) {
+               if (info[k].core == info[j].core) {
+                  order[n++] = info[k];
+               }
+            }
+         } // End for j
+      } // End for nodes
+      break;
+
+      case AFFINITY_SCATTER: {
+      // First threads of every core before any sibling, and alternate the
+      // nodes at each step
+      int maxNode = 0, maxSmt = 0;
+
+      for (int j = 0; j < numCpus; j++) {
+         maxNode = (info[j].node > maxNode) ? info[j].node : maxNode;
+         maxSmt = (info[j].smt > maxSmt) ? info[j].smt : maxSmt;
+      }
+      for (int smt = 0; smt <= maxSmt; smt++) {
+         int more = 1;
+         for (int rank = 0; more; rank++) {
+            more = 0;
+            for (int nd = 0; nd <= maxNode; nd++) {
+               // The rank-th CPU of this node at this sibling level
+               int seen = 0;
+               for (int j = 0; j < numCpus; j++) {
+                  if (info[j].node == nd && info[j].smt == smt) {
+                     if (seen++ == rank) {
+                        order[n++] = info[j];
+                        more = 1;
+                        break;
+                     }
+                  }
+               } // End for j
+            } // End for nodes
+         } // End for rank
+      } // End for smt
+      } break;
+   } // End switch
+
+   if (n == 0) {
+      free(info);
+      return(-1);
+   }
+   for (int i = 0; i < numThreads; i++) {
+      cpu[i] = order[i % n].cpu;
+      node[i] = order[i % n].node;
+   }
+   free(info);
+   return(0);
+} // End placeWorkers
+
+
+/****************************************************************************
+  Count the NUMA nodes of this machine
+
+  int placeNumNodes(void)
+  Returns: int - number of online nodes, 1 when sysfs has no node directory
+  Errors: none
+****************************************************************************/
+int placeNumNodes(void) {
+   char set[MAX_CPUS];
+   int n = readList(SYSFS_NODE "/online", set, MAX_CPUS);
+
+   return((n > 0) ? n : 1);
+} // End placeNumNodes
+
+
+/****************************************************************************
+  Parse a Linux cpu list such as "0-3,8,10-11" into a flag array and,
+  when seq is not NULL, the list of entries in the order they appear
+
+  Returns: int - number of entries set, -1 on a syntax error
+****************************************************************************/
+static int parseList(const char *list, char *set, int max, int *seq) {
+   const char *p = list;
+   char *endp;
+   long lo, hi;
+   int n = 0;
+
+   memset(set, 0, max);
+   while (*p != '\0' && *p != '\n') {
+      lo = strtol(p, &endp, 10);
+      if (endp == p || lo < 0) {
+         return(-1);
+      }
+      hi = lo;
+      p = endp;
+      if (*p == '-') {
+         hi = strtol(p + 1, &endp, 10);
+         if (endp == p + 1 || hi < lo) {
+            return(-1);
+         }
+         p = endp;
+      }
+      for (long c = lo; c <= hi && c < max; c++) {
+         if (!set[c] && seq != NULL) {
+            seq[n] = (int)c;
+         }
+         n += !set[c];
+         set[c] = 1;
+      }
+      if (*p == ',') {
+         p++;
+      }
+      else if (*p != '\0' && *p != '\n') {
+         return(-1);
+      }
+   } // End while
+   return(n);
+} // End parseList
+
+
+/****************************************************************************
+  Read a cpu list file from sysfs
+
+  Returns: int - number of entries, -1 if the file can not be read
+****************************************************************************/
+static int readList(const char *path, char *set, int max) {
+   char line[4096];
+   FILE *fp = fopen(path, "r");
+
+   if (fp == NULL) {
+      return(-1);
+   }
+   if (fgets(line, sizeof(line), fp) == NULL) {
+      fclose(fp);
+      return(-1);
+   }
+   fclose(fp);
+   return(parseList(line, set, max, NULL));
+} // End readList
+
+
+/****************************************************************************
+  Build the list of CPUs this process may use, in CPU number order, with
+  their node, core and sibling rank.  Siblings the process may not use are
+  ignored so every core has a first thread (smt 0) in the list.
+
+  Returns: int - number of CPUs found
+****************************************************************************/
+static int readTopology(struct CpuInfo_s *info) {
+   char path[256];
+   char set[MAX_CPUS], nodes[MAX_CPUS];
+   short nodeOf[MAX_CPUS];
+   cpu_set_t allowed;
+   int n = 0;
+
+   if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+      CPU_ZERO(&allowed);
+      CPU_SET(0, &allowed);
+   }
+
+   // The node of a CPU is the one whose cpulist holds it
+   memset(nodeOf, 0, sizeof(nodeOf));
+   if (readList(SYSFS_NODE "/online", nodes, MAX_CPUS) > 0) {
+      for (int nd = 0; nd < MAX_CPUS; nd++) {
+         if (!nodes[nd]) {
+            continue;
+         }
+         snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", nd);
+         if (readList(path, set, MAX_CPUS) > 0) {
+            for (int c = 0; c < MAX_CPUS; c++) {
+               if (set[c]) {
+                  nodeOf[c] = nd;
+               }
+            }
+         }
+      } // End for nodes
+   }
+
+   for (int c = 0; c < MAX_CPUS; c++) {
+      if (!CPU_ISSET(c, &allowed)) {
+         continue;
+      }
+      info[n].cpu = c;
+      info[n].node = nodeOf[c];
+      info[n].core = c;
+      info[n].smt = 0;
+
+      // The core is named after its lowest usable sibling
+      snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list", c);
+      if (readList(path, set, MAX_CPUS) > 0) {
+         for (int s = 0; s < c; s++) {
+            if (set[s] && CPU_ISSET(s, &allowed)) {
+               if (info[n].core == c) {
+                  info[n].core = s;
+               }
+               info[n].smt++;
+            }
+         }
+      }
+      n++;
+   } // End for c
+   return(n);
+} // End readTopology
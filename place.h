@@ -0,0 +1,30 @@
+/******************************************************************************
+* CPU affinity and NUMA placement of the hw13 workers
+*
+* The topology is read from sysfs (/sys/devices/system/node and the cpu
+* topology directories) and restricted to the CPUs this process may run on,
+* so no NUMA library is needed.  A machine without the node directory is
+* treated as a single node and every policy still works.
+*
+* Placement specs:
+*   none    - do not pin, the scheduler decides
+*   compact - fill one node before the next, hyper-thread siblings adjacent
+*   scatter - round robin over the nodes, one CPU per core before siblings
+*   list    - an explicit cpu list such as 0-3,8,10 (worker i gets entry i)
+* When there are more workers than CPUs the assignment wraps around.
+******************************************************************************/
+#ifndef _PLACE_H_
+#define _PLACE_H_
+
+/* Placement policies */
+#define AFFINITY_NONE       (0)
+#define AFFINITY_COMPACT    (1)
+#define AFFINITY_SCATTER    (2)
+#define AFFINITY_LIST       (3)
+
+/* Function prototypes */
+int placeAffinity(const char *spec);
+int placeWorkers(const char *spec, int numThreads, int *cpu, int *node);
+int placeNumNodes(void);
+
+#endif /* _PLACE_H_ */
@@ -0,0 +1,457 @@
+//  Persistent worker pool and chunk schedulers for hw13
+//
+//  The threads are created once by poolCreate() and sleep on their own
+//  condition variable between jobs, so a program that runs several parallel
+//  phases only pays for pthread_create()/pthread_join() once.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "pool.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Worker states
+#define WORKER_IDLE     (0)     // Waiting for poolStart()
+#define WORKER_BUSY     (1)     // Running the job routine
+#define WORKER_DONE     (2)     // Finished, waiting for poolJoin()
+#define WORKER_EXIT     (3)     // Asked to terminate by poolDestroy()
+
+// Per-worker control block, one cache line apart to avoid false sharing
+struct PoolWorker_s {
+   pthread_t thread;          // The persistent thread
+   pthread_mutex_t lock;      // Protects the fields below
+   pthread_cond_t cond;       // Signalled on every state change
+   int state;                 // One of the WORKER_xxx values
+   void *(*fn)(void *);       // Job routine
+   void *arg;                 // Job routine argument
+   void *rc;                  // Job routine return value
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct Pool_s {
+   int numThreads;            // Number of workers
+   struct PoolWorker_s *workers;
+};
+
+// The chunk numbers of one deque must fit in 32 bits
+#define MAX_DEQUE_CHUNKS    (0xFFFFFFFFL)
+
+static void *poolMain(void *data);
+
+
+/****************************************************************************
+  Create a pool of persistent worker threads
+
+  struct Pool_s *poolCreate(int numThreads)
+  Where: int numThreads - number of worker threads to create
+  Returns: struct Pool_s * - the pool, NULL on failure
+  Errors: none
+****************************************************************************/
+struct Pool_s *poolCreate(int numThreads) {
+   struct Pool_s *pool;
+
+   if (numThreads < 1) {
+      return(NULL);
+   }
+   pool = malloc(sizeof(*pool));
+   if (pool == NULL) {
+      return(NULL);
+   }
+   if (posix_memalign((void **)&pool->workers, CACHE_LINE_SIZE,
+                      numThreads*sizeof(struct PoolWorker_s))) {
+      free(pool);
+      return(NULL);
+   }
+   memset(pool->workers, 0, numThreads*sizeof(struct PoolWorker_s));
+
+   for (pool->numThreads = 0; pool->numThreads < numThreads; pool->numThreads++) {
+      struct PoolWorker_s *w = &pool->workers[pool->numThreads];
+
+      pthread_mutex_init(&w->lock, NULL);
+      pthread_cond_init(&w->cond, NULL);
+      w->state = WORKER_IDLE;
+      if (pthread_create(&w->thread, NULL, poolMain, w)) {
+         pthread_mutex_destroy(&w->lock);
+         pthread_cond_destroy(&w->cond);
+         poolDestroy(pool);
+         return(NULL);
+      }
+   } // End for workers
+   return(pool);
+} // End poolCreate
+
+
+/****************************************************************************
+  Hand a job routine to one idle worker, the pool equivalent of
+  pthread_create()
+
+  int poolStart(struct Pool_s *pool, int worker, void *(*fn)(void *), void *arg)
+  Where: struct Pool_s *pool - the pool
+         int worker          - worker number 0..numThreads-1
+         void *(*fn)(void *) - the job routine
+         void *arg           - argument passed to the job routine
+  Returns: int - 0 on success, -1 if the worker is unknown or not idle
+  Errors: none
+****************************************************************************/
+int poolStart(struct Pool_s *pool, int worker, void *(*fn)(void *), void *arg) {
+   struct PoolWorker_s *w;
+   int rc = 0;
+
+   if (worker < 0 || worker >= pool->numThreads) {
+      return(-1);
+   }
+   w = &pool->workers[worker];
+   pthread_mutex_lock(&w->lock);
+   if (w->state != WORKER_IDLE) {
+      rc = -1;
+   }
+   else {
+      w->fn = fn;
+      w->arg = arg;
+      w->state = WORKER_BUSY;
+      pthread_cond_broadcast(&w->cond);
+   }
+   pthread_mutex_unlock(&w->lock);
+   return(rc);
+} // End poolStart
+
+
+/****************************************************************************
+  Wait for a worker to finish its job, the pool equivalent of
+  pthread_join().  The worker is idle again afterwards.
+
+  int poolJoin(struct Pool_s *pool, int worker, void **rcp)
+  Where: struct Pool_s *pool - the pool
+         int worker          - worker number 0..numThreads-1
+         void **rcp          - receives the job return value, may be NULL
+  Returns: int - 0 on success, -1 if the worker has no job
+  Errors: none
+****************************************************************************/
+int poolJoin(struct Pool_s *pool, int worker, void **rcp) {
+   struct PoolWorker_s *w;
+
+   if (worker < 0 || worker >= pool->numThreads) {
+      return(-1);
+   }
+   w = &pool->workers[worker];
+   pthread_mutex_lock(&w->lock);
+   if (w->state == WORKER_IDLE) {
+      pthread_mutex_unlock(&w->lock);
+      return(-1);
+   }
+   while (w->state != WORKER_DONE) {
+      pthread_cond_wait(&w->cond, &w->lock);
+   }
+   if (rcp != NULL) {
+      *rcp = w->rc;
+   }
+   w->state = WORKER_IDLE;
+   pthread_mutex_unlock(&w->lock);
+   return(0);
+} // End poolJoin
+
+
+/****************************************************************************
+  Return the pthread handle of a worker
+
+  pthread_t poolThread(struct Pool_s *pool, int worker)
+  Where: struct Pool_s *pool - the pool
+         int worker          - worker number 0..numThreads-1
+  Returns: pthread_t - the worker thread
+  Errors: none
+****************************************************************************/
+pthread_t poolThread(struct Pool_s *pool, int worker) {
+   return(pool->workers[worker].thread);
+} // End poolThread
+
+
+/****************************************************************************
+  Pin a worker thread to one CPU.  The pin lasts for the life of the pool.
+
+  int poolPin(struct Pool_s *pool, int worker, int cpu)
+  Where: struct Pool_s *pool - the pool
+         int worker          - worker number 0..numThreads-1
+         int cpu             - the CPU number, -1 leaves the worker unpinned
+  Returns: int - 0 on success, the pthread_setaffinity_np() error otherwise
+  Errors: none
+****************************************************************************/
+int poolPin(struct Pool_s *pool, int worker, int cpu) {
+   cpu_set_t set;
+
+   if (worker < 0 || worker >= pool->numThreads) {
+      return(-1);
+   }
+   if (cpu < 0) {
+      return(0);
+   }
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return(pthread_setaffinity_np(pool->workers[worker].thread, sizeof(set), &set));
+} // End poolPin
+
+
+/****************************************************************************
+  Terminate all the worker threads and free the pool.  Workers still busy
+  are allowed to finish their current job first.
+
+  void poolDestroy(struct Pool_s *pool)
+  Where: struct Pool_s *pool - the pool, may be NULL
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void poolDestroy(struct Pool_s *pool) {
+   if (pool == NULL) {
+      return;
+   }
+   for (int i = 0; i < pool->numThreads; i++) {
+      struct PoolWorker_s *w = &pool->workers[i];
+
+      pthread_mutex_lock(&w->lock);
+      while (w->state == WORKER_BUSY) {
+         pthread_cond_wait(&w->cond, &w->lock);
+      }
+      w->state = WORKER_EXIT;
+      pthread_cond_broadcast(&w->cond);
+      pthread_mutex_unlock(&w->lock);
+      pthread_join(w->thread, NULL);
+      pthread_mutex_destroy(&w->lock);
+      pthread_cond_destroy(&w->cond);
+   } // End for workers
+   free(pool->workers);
+   free(pool);
+} // End poolDestroy
+
+
+/****************************************************************************
+  The persistent thread routine.  Sleeps until a job is posted, runs it and
+  reports completion, until poolDestroy() asks it to exit.
+****************************************************************************/
+static void *poolMain(void *data) {
+   struct PoolWorker_s *w = data;
+
+   pthread_mutex_lock(&w->lock);
+   for (;;) {
+      while (w->state != WORKER_BUSY && w->state != WORKER_EXIT) {
+         pthread_cond_wait(&w->cond, &w->lock);
+      }
+      if (w->state == WORKER_EXIT) {
+         break;
+      }
+      pthread_mutex_unlock(&w->lock);
+      void *rc = w->fn(w->arg);
+      pthread_mutex_lock(&w->lock);
+      w->rc = rc;
+      w->state = WORKER_DONE;
+      pthread_cond_broadcast(&w->cond);
+   } // End for ever
+   pthread_mutex_unlock(&w->lock);
+   return(NULL);
+} // End poolMain
+
+
+/****************************************************************************
+  Initialize a chunk scheduler for one job
+
+  int schedInit(struct Sched_s *sched, int policy, long count, long chunk,
+                int numWorkers)
+  Where: struct Sched_s *sched - scheduler to initialize
+         int policy            - one of the POLICY_xxx values
+         long count            - number of elements, indexes 0..count-1
+         long chunk            - elements per chunk, minimum for guided
+         int numWorkers        - number of workers calling schedNext()
+  Returns: int - 0 on success, -1 on a bad argument or malloc failure
+  Errors: none
+****************************************************************************/
+int schedInit(struct Sched_s *sched, int policy, long count, long chunk,
+              int numWorkers) {
+   memset(sched, 0, sizeof(*sched));
+   if (count < 0 || chunk < 1 || numWorkers < 1) {
+      return(-1);
+   }
+   sched->policy = policy;
+   sched->numWorkers = numWorkers;
+   sched->count = count;
+   sched->chunk = chunk;
+   sched->next = 0;
+
+   switch (policy) {
+      case POLICY_DYNAMIC:
+      case POLICY_GUIDED:
+      break;
+
+      case POLICY_STATIC:
+      case POLICY_STEAL:
+      if (posix_memalign((void **)&sched->deques, CACHE_LINE_SIZE,
+                         numWorkers*sizeof(struct Deque_s))) {
+         sched->deques = NULL;
+         return(-1);
+      }
+      // The remainder is spread over the first count%numWorkers blocks
+      for (int i = 0; i < numWorkers; i++) {
+         struct Deque_s *d = &sched->deques[i];
+         long nChunks;
+
+         d->lo = (count/numWorkers)*i + (i < count%numWorkers ? i : count%numWorkers);
+         d->hi = d->lo + count/numWorkers + (i < count%numWorkers);
+         nChunks = (d->hi - d->lo + chunk - 1)/chunk;
+         if (nChunks > MAX_DEQUE_CHUNKS) {
+            free(sched->deques);
+            sched->deques = NULL;
+            return(-1);
+         }
+         d->ends = (uint64_t)nChunks;
+      } // End for workers
+      break;
+
+      default:
+      return(-1);
+   } // End switch
+   return(0);
+} // End schedInit
+
+
+/****************************************************************************
+  Take one chunk from a deque.  The owner takes from the head, thieves take
+  from the tail so they rarely collide with the owner.
+****************************************************************************/
+static int dequeTake(struct Deque_s *d, long chunk, int fromTail,
+                     long *begin, long *end) {
+   uint64_t ends = __atomic_load_n(&d->ends, __ATOMIC_ACQUIRE);
+   uint64_t head, tail, taken;
+
+   do {
+      head = ends >> 32;
+      tail = ends & 0xFFFFFFFFu;
+      if (head >= tail) {
+         return(0);
+      }
+      if (fromTail) {
+         taken = tail - 1;
+         tail--;
+      }
+      else {
+         taken = head;
+         head++;
+      }
+   } while (!__atomic_compare_exchange_n(&d->ends, &ends, (head << 32) | tail,
+                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+   *begin = d->lo + (long)taken*chunk;
+   *end = *begin + chunk;
+   if (*end > d->hi) {
+      *end = d->hi;
+   }
+   return(1);
+} // End dequeTake
+
+
+/****************************************************************************
+  Get the next chunk of work for a worker
+
+  int schedNext(struct Sched_s *sched, int worker, long *begin, long *end)
+  Where: struct Sched_s *sched - the job scheduler
+         int worker            - worker number 0..numWorkers-1
+         long *begin           - receives the first index of the chunk
+         long *end             - receives one past the last index
+  Returns: int - 1 if a chunk was assigned, 0 when the job is exhausted
+  Errors: none
+****************************************************************************/
+int schedNext(struct Sched_s *sched, int worker, long *begin, long *end) {
+   long cur, size;
+
+   switch (sched->policy) {
+      case POLICY_STATIC:
+      return(dequeTake(&sched->deques[worker], sched->chunk, 0, begin, end));
+
+      case POLICY_DYNAMIC:
+      cur = __atomic_fetch_add(&sched->next, sched->chunk, __ATOMIC_RELAXED);
+      if (cur >= sched->count) {
+         return(0);
+      }
+      *begin = cur;
+      *end = (cur + sched->chunk < sched->count) ? cur + sched->chunk : sched->count;
+      return(1);
+
+      case POLICY_GUIDED:
+      cur = __atomic_load_n(&sched->next, __ATOMIC_RELAXED);
+      do {
+         if (cur >= sched->count) {
+            return(0);
+         }
+         // Take a share of what is left, never less than the chunk size
+         size = (sched->count - cur)/(2*sched->numWorkers);
+         if (size < sched->chunk) {
+            size = sched->chunk;
+         }
+         if (size > sched->count - cur) {
+            size = sched->count - cur;
+         }
+      } while (!__atomic_compare_exchange_n(&sched->next, &cur, cur + size, 0,
+                           __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+      *begin = cur;
+      *end = cur + size;
+      return(1);
+
+      case POLICY_STEAL:
+      if (dequeTake(&sched->deques[worker], sched->chunk, 0, begin, end)) {
+         return(1);
+      }
+      // Own deque is empty, try the others starting with the next worker
+      for (int i = 1; i < sched->numWorkers; i++) {
+         int victim = (worker + i) % sched->numWorkers;
+         if (dequeTake(&sched->deques[victim], sched->chunk, 1, begin, end)) {
+            return(1);
+         }
+      } // End for victims
+      return(0);
+   } // End switch
+   return(0);
+} // End schedNext
+
+
+/****************************************************************************
+  Release the scheduler resources
+
+  void schedFree(struct Sched_s *sched)
+  Where: struct Sched_s *sched - the job scheduler
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void schedFree(struct Sched_s *sched) {
+   free(sched->deques);
+   sched->deques = NULL;
+} // End schedFree
+
+
+/****************************************************************************
+  Convert between scheduling policy names and values
+
+  int schedPolicy(const char *name)
+  Where: const char *name - static, dynamic, guided or steal
+  Returns: int - the POLICY_xxx value, -1 if unknown
+
+  const char *schedName(int policy)
+  Where: int policy - one of the POLICY_xxx values
+  Returns: const char * - the policy name
+****************************************************************************/
+static const char *policyNames[] = {"static", "dynamic", "guided", "steal"};
+
+int schedPolicy(const char *name) {
+   for (int i = 0; i < (int)(sizeof(policyNames)/sizeof(policyNames[0])); i++) {
+      if (strcmp(name, policyNames[i]) == 0) {
+         return(i);
+      }
+   }
+   return(-1);
+} // End schedPolicy
+
+const char *schedName(int policy) {
+   if (policy < 0 || policy >= (int)(sizeof(policyNames)/sizeof(policyNames[0]))) {
+      return("unknown");
+   }
+   return(policyNames[policy]);
+} // End schedName
@@ -0,0 +1,70 @@
+/******************************************************************************
+* Persistent worker pool and chunk schedulers for hw13
+*
+* The pool owns a fixed set of threads that are created once and then handed
+* work with poolStart()/poolJoin(), which mirror pthread_create() and
+* pthread_join() so a worker routine looks exactly like a thread routine.
+*
+* A scheduler (struct Sched_s) splits an index range [0, count) into chunks
+* and hands them out to the workers according to a policy:
+*   static  - one contiguous block per worker, handed out chunk by chunk
+*   dynamic - fixed size chunks taken from a shared atomic cursor
+*   guided  - chunks shrink with the remaining work, shared atomic cursor
+*   steal   - static blocks in per-worker deques, idle workers steal chunks
+*             from the tail of the other workers' deques
+******************************************************************************/
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Chunk scheduling policies */
+#define POLICY_STATIC       (0)
+#define POLICY_DYNAMIC      (1)
+#define POLICY_GUIDED       (2)
+#define POLICY_STEAL        (3)
+
+/* Default number of elements handed out per chunk */
+#define DEFAULT_CHUNK       (64*1024)
+
+/* Size used to keep per-thread data on separate cache lines */
+#define CACHE_LINE_SIZE     (64)
+
+/* One per-worker deque, the chunk numbers head..tail-1 are still queued.
+   Both ends live in one 64 bit word so owner and thieves can use CAS */
+struct Deque_s {
+   uint64_t ends;       // head in the upper 32 bits, tail in the lower 32
+   long lo;             // First element index owned by this deque
+   long hi;             // One past the last element index
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* Chunk scheduler state shared by all workers of one job */
+struct Sched_s {
+   int policy;                // One of the POLICY_xxx values
+   int numWorkers;            // Number of workers taking chunks
+   long count;                // Number of elements in the job
+   long chunk;                // Elements per chunk (minimum for guided)
+   struct Deque_s *deques;    // Per-worker deques for static and steal
+   long next __attribute__((aligned(CACHE_LINE_SIZE))); // Shared cursor
+};
+
+struct Pool_s;
+
+/* Pool function prototypes */
+struct Pool_s *poolCreate(int numThreads);
+int poolStart(struct Pool_s *pool, int worker, void *(*fn)(void *), void *arg);
+int poolJoin(struct Pool_s *pool, int worker, void **rcp);
+pthread_t poolThread(struct Pool_s *pool, int worker);
+int poolPin(struct Pool_s *pool, int worker, int cpu);
+void poolDestroy(struct Pool_s *pool);
+
+/* Scheduler function prototypes */
+int schedInit(struct Sched_s *sched, int policy, long count, long chunk,
+              int numWorkers);
+int schedNext(struct Sched_s *sched, int worker, long *begin, long *end);
+void schedFree(struct Sched_s *sched);
+int schedPolicy(const char *name);
+const char *schedName(int policy);
+
+#endif /* _POOL_H_ */
@@ -0,0 +1,112 @@
+//  Reduction and prefix sum kernels for hw13
+//
+//  SSE2 is part of every x86-64 CPU so the kernels use it without a runtime
+//  check.  The sum keeps four accumulator registers, the scan does the
+//  in-register log step scan and carries the last lane to the next register.
+
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+#ifdef SCAN_SSE2
+#ifdef WIDE_ELEM
+#define V128_ADD            _mm_add_epi64
+#else
+#define V128_ADD            _mm_add_epi32
+#endif
+// Elements per register
+#define L128 ((long)(16/sizeof(elem_t)))
+#endif
+
+
+/****************************************************************************
+  Sum a range of elements
+
+  uelem_t scanSum(const elem_t *src, long count)
+  Where: const elem_t *src - the elements
+         long count        - number of elements
+  Returns: uelem_t - their sum, wrapped
+  Errors: none
+****************************************************************************/
+uelem_t scanSum(const elem_t *src, long count) {
+   uelem_t sum = 0;
+   long k = 0;
+
+#ifdef SCAN_SSE2
+   __m128i acc0 = _mm_setzero_si128(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+   uelem_t lanes[16/sizeof(elem_t)];
+
+   for (; k + 4*L128 <= count; k += 4*L128) {
+      acc0 = V128_ADD(acc0, _mm_loadu_si128((const __m128i *)&src[k]));
+      acc1 = V128_ADD(acc1, _mm_loadu_si128((const __m128i *)&src[k + L128]));
+      acc2 = V128_ADD(acc2, _mm_loadu_si128((const __m128i *)&src[k + 2*L128]));
+      acc3 = V128_ADD(acc3, _mm_loadu_si128((const __m128i *)&src[k + 3*L128]));
+   }
+   acc0 = V128_ADD(V128_ADD(acc0, acc1), V128_ADD(acc2, acc3));
+   _mm_storeu_si128((__m128i *)lanes, acc0);
+   for (long j = 0; j < L128; j++) {
+      sum += lanes[j];
+   }
+#endif
+   for (; k < count; k++) {
+      sum += (uelem_t)src[k];
+   }
+   return(sum);
+} // End scanSum
+
+
+/****************************************************************************
+  Replace a range of elements with their running totals, in place
+
+  uelem_t scanInclusive(elem_t *data, long count, uelem_t carry)
+  Where: elem_t *data  - the elements
+         long count    - number of elements
+         uelem_t carry - total of everything before data[0]
+  Returns: uelem_t - the last running total, carry if count is 0
+  Errors: none
+****************************************************************************/
+uelem_t scanInclusive(elem_t *data, long count, uelem_t carry) {
+   long k = 0;
+
+#ifdef SCAN_SSE2
+   uelem_t last[16/sizeof(elem_t)];
+#ifdef WIDE_ELEM
+   __m128i c = _mm_set1_epi64x((long long)carry);
+#else
+   __m128i c = _mm_set1_epi32((int)carry);
+#endif
+
+   for (; k + L128 <= count; k += L128) {
+      __m128i x = _mm_loadu_si128((const __m128i *)&data[k]);
+
+      // Log step scan inside the register, then add the carry in
+      x = V128_ADD(x, _mm_slli_si128(x, sizeof(elem_t)));
+#ifndef WIDE_ELEM
+      x = V128_ADD(x, _mm_slli_si128(x, 2*sizeof(elem_t)));
+#endif
+      x = V128_ADD(x, c);
+      _mm_storeu_si128((__m128i *)&data[k], x);
+
+      // Broadcast the last lane as the next carry
+#ifdef WIDE_ELEM
+      c = _mm_unpackhi_epi64(x, x);
+#else
+      c = _mm_shuffle_epi32(x, 0xFF);
+#endif
+   }
+   _mm_storeu_si128((__m128i *)last, c);
+   carry = last[0];
+#endif
+   for (; k < count; k++) {
+      carry += (uelem_t)data[k];
+      data[k] = (elem_t)carry;
+   }
+   return(carry);
+} // End scanInclusive
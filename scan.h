@@ -0,0 +1,20 @@
+/******************************************************************************
+* Reduction and prefix sum kernels for hw13
+*
+* The parallel passes split the array into the worker segments and use the
+* reduce-then-scan scheme: every worker sums its segment, the segment sums
+* are turned into an exclusive scan (the offset of each segment) by one
+* thread, then every worker scans its segment starting from its offset.
+* That reads the array twice and writes it once, the local scan plus fix-up
+* scheme would write it twice.  All sums wrap in the element type.
+******************************************************************************/
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include "fill.h"
+
+/* Function prototypes */
+uelem_t scanSum(const elem_t *src, long count);
+uelem_t scanInclusive(elem_t *data, long count, uelem_t carry);
+
+#endif /* _SCAN_H_ */
@@ -0,0 +1,157 @@
+//  Per-thread run statistics for hw13
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "stats.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Rates with a zero time come out as 0 rather than inf, which JSON lacks
+#define RATE(x, s)  (((s) > 0.0) ? (double)(x)/(s) : 0.0)
+
+
+/****************************************************************************
+  Clear a histogram
+
+  void histReset(struct Hist_s *hist)
+  Where: struct Hist_s *hist - the histogram
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void histReset(struct Hist_s *hist) {
+   memset(hist, 0, sizeof(*hist));
+} // End histReset
+
+
+/****************************************************************************
+  Record one chunk time
+
+  void histAdd(struct Hist_s *hist, long long ns)
+  Where: struct Hist_s *hist - the histogram
+         long long ns        - the chunk time in nanoseconds
+  Returns: nothing
+  Errors: none
+****************************************************************************/
+void histAdd(struct Hist_s *hist, long long ns) {
+   if (ns < 1) {
+      ns = 1;
+   }
+   hist->bucket[63 - __builtin_clzll((unsigned long long)ns)]++;
+   hist->count++;
+   if (ns > hist->maxNs) {
+      hist->maxNs = ns;
+   }
+} // End histAdd
+
+
+/****************************************************************************
+  Estimate a percentile of the recorded times
+
+  long long histPercentile(const struct Hist_s *hist, double p)
+  Where: const struct Hist_s *hist - the histogram
+         double p                  - the percentile, 0.0 to 1.0
+  Returns: long long - the upper end of the bucket holding the percentile,
+                       never more than the slowest chunk, 0 if empty
+  Errors: none
+****************************************************************************/
+long long histPercentile(const struct Hist_s *hist, double p) {
+   long rank = (long)(p*hist->count + 0.999999);
+   long seen = 0;
+
+   if (hist->count == 0) {
+      return(0);
+   }
+   if (rank < 1) {
+      rank = 1;
+   }
+   for (int b = 0; b < HIST_BUCKETS; b++) {
+      seen += hist->bucket[b];
+      if (seen >= rank) {
+         long long top = (b < 62) ? (2LL << b) - 1 : hist->maxNs;
+         return((top < hist->maxNs) ? top : hist->maxNs);
+      }
+   }
+   return(hist->maxNs);
+} // End histPercentile
+
+
+/****************************************************************************
+  Write the run statistics, CSV if the name ends in .csv else JSON.  Idle
+  time is the part of the fill a worker was not busy, mostly waiting for
+  the slowest worker before the join.
+
+  int statsWrite(const char *path, const struct RunStats_s *run,
+                 const struct ThreadStats_s *threads)
+  Where: const char *path                     - output file
+         const struct RunStats_s *run         - the run description
+         const struct ThreadStats_s *threads  - numThreads worker entries
+  Returns: int - 0 on success, -1 with errno set on failure
+  Errors: none
+****************************************************************************/
+int statsWrite(const char *path, const struct RunStats_s *run,
+               const struct ThreadStats_s *threads) {
+   size_t len = strlen(path);
+   int csv = (len >= 4 && strcmp(path + len - 4, ".csv") == 0);
+   double gb = 1e-9*run->elemSize;
+   FILE *fp = fopen(path, "w");
+   int err;
+
+   if (fp == NULL) {
+      return(-1);
+   }
+
+   if (csv) {
+      fprintf(fp, "thread,elements,chunks,busy_sec,cpu_sec,idle_sec,"
+                  "elem_per_sec,gb_per_sec,p50_us,p99_us,max_us\n");
+   }
+   else {
+      fprintf(fp, "{\n  \"threads\": %d,\n  \"elements\": %ld,\n"
+                  "  \"bytes\": %.0f,\n  \"policy\": \"%s\",\n"
+                  "  \"kernel\": \"%s\",\n  \"chunk\": %ld,\n"
+                  "  \"fill_sec\": %.9f,\n  \"elem_per_sec\": %.6g,\n"
+                  "  \"gb_per_sec\": %.6g,\n  \"per_thread\": [\n",
+              run->numThreads, run->elements, (double)run->elements*run->elemSize,
+              run->policy, run->kernel, run->chunk, run->fillSeconds,
+              RATE(run->elements, run->fillSeconds),
+              RATE(gb*run->elements, run->fillSeconds));
+   }
+
+   for (int i = 0; i < run->numThreads; i++) {
+      const struct ThreadStats_s *t = &threads[i];
+      double idle = run->fillSeconds - t->busySeconds;
+
+      idle = (idle > 0.0) ? idle : 0.0;
+      fprintf(fp, csv ? "%d,%ld,%ld,%.9f,%.9f,%.9f,%.6g,%.6g,%.3f,%.3f,%.3f\n"
+                      : "    {\"thread\": %d, \"elements\": %ld, \"chunks\": %ld, "
+                        "\"busy_sec\": %.9f, \"cpu_sec\": %.9f, \"idle_sec\": %.9f, "
+                        "\"elem_per_sec\": %.6g, \"gb_per_sec\": %.6g, "
+                        "\"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}",
+              i, t->elements, t->hist.count, t->busySeconds, t->cpuSeconds, idle,
+              RATE(t->elements, t->busySeconds),
+              RATE(gb*t->elements, t->busySeconds),
+              1e-3*histPercentile(&t->hist, 0.50),
+              1e-3*histPercentile(&t->hist, 0.99), 1e-3*t->hist.maxNs);
+      if (!csv) {
+         fprintf(fp, (i + 1 < run->numThreads) ? ",\n" : "\n");
+      }
+   } // End for threads
+
+   if (csv) {
+      // The whole run as a last row, busy time is the fill wall time
+      fprintf(fp, "all,%ld,,%.9f,,,%.6g,%.6g,,,\n", run->elements, run->fillSeconds,
+              RATE(run->elements, run->fillSeconds),
+              RATE(gb*run->elements, run->fillSeconds));
+   }
+   else {
+      fprintf(fp, "  ]\n}\n");
+   }
+
+   err = ferror(fp) ? EIO : 0;
+   if (fclose(fp) && err == 0) {
+      err = errno;
+   }
+   errno = err;
+   return((err == 0) ? 0 : -1);
+} // End statsWrite
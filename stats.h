@@ -0,0 +1,53 @@
+/******************************************************************************
+* Per-thread run statistics for hw13
+*
+* Every worker records how long each of its chunks took in a histogram with
+* one bucket per power of two nanoseconds, so recording is a bit scan and an
+* increment and percentiles are accurate to a factor of two.  At the end of
+* the run the per-thread numbers and the totals are written as JSON, or as
+* CSV when the file name ends in .csv.
+******************************************************************************/
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pool.h"
+
+/* Bucket b counts the chunks that took 2^b to 2^(b+1)-1 ns */
+#define HIST_BUCKETS        (64)
+
+/* Chunk latency histogram */
+struct Hist_s {
+   uint64_t bucket[HIST_BUCKETS];
+   long count;          // Number of chunks recorded
+   long long maxNs;     // Slowest chunk
+};
+
+/* Statistics of one worker for one job, only written by that worker */
+struct ThreadStats_s {
+   long elements;       // Elements the worker filled
+   double busySeconds;  // Wall time from its start to its last chunk
+   double cpuSeconds;   // CPU time of the worker
+   struct Hist_s hist;  // Chunk fill times
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* Description of the whole run */
+struct RunStats_s {
+   int numThreads;
+   long elements;
+   size_t elemSize;     // Bytes per element
+   double fillSeconds;  // Wall time of the fill from start to last join
+   const char *policy;
+   const char *kernel;
+   long chunk;
+};
+
+/* Function prototypes */
+void histReset(struct Hist_s *hist);
+void histAdd(struct Hist_s *hist, long long ns);
+long long histPercentile(const struct Hist_s *hist, double p);
+int statsWrite(const char *path, const struct RunStats_s *run,
+               const struct ThreadStats_s *threads);
+
+#endif /* _STATS_H_ */
@@ -0,0 +1,224 @@
+//  STREAM style memory bandwidth kernels for hw13
+//
+//  The kernels use SSE2 (part of every x86-64 CPU) two doubles per register
+//  and four registers per iteration, with a scalar loop for the tail.  The
+//  arrays are initialized by the workers that use them so their pages are
+//  first touched on the right node.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#define EN_TIME
+#include "Timers.h"
+#include "stream.h"
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#define STREAM_SSE2
+#include <emmintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+static const char *kernelNames[] = {"copy", "scale", "add", "triad"};
+
+// Bytes moved per element by each kernel
+static const int kernelBytes[STREAM_KERNELS] = {16, 16, 24, 24};
+
+// STREAM's scalar and initial values
+#define STREAM_SCALAR       (3.0)
+#define INIT_A              (1.0)
+#define INIT_B              (2.0)
+#define INIT_C              (0.0)
+
+// Relative error allowed in the final values
+#define EPSILON             (1e-13)
+#define ABS(x)              (((x) < 0.0) ? -(x) : (x))
+
+// Pass that only sets the initial values
+#define STREAM_INIT         (-1)
+
+// One worker's part of a pass
+struct StreamJob_s {
+   double *a, *b, *c;
+   long start;          // First element of the segment
+   long size;           // Elements in the segment
+   int kernel;          // STREAM_xxx or STREAM_INIT
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+
+/****************************************************************************
+  Run one kernel over one segment
+****************************************************************************/
+static void *streamWorker(void *data) {
+   struct StreamJob_s *job = data;
+   double *a = job->a + job->start, *b = job->b + job->start, *c = job->c + job->start;
+   const double s = STREAM_SCALAR;
+   long n = job->size, k = 0;
+
+#ifdef STREAM_SSE2
+   const __m128d vs = _mm_set1_pd(s);
+
+   // Two doubles per register, four registers per iteration
+   switch (job->kernel) {
+      case STREAM_COPY:
+      for (; k + 8 <= n; k += 8) {
+         _mm_storeu_pd(&c[k], _mm_loadu_pd(&a[k]));
+         _mm_storeu_pd(&c[k + 2], _mm_loadu_pd(&a[k + 2]));
+         _mm_storeu_pd(&c[k + 4], _mm_loadu_pd(&a[k + 4]));
+         _mm_storeu_pd(&c[k + 6], _mm_loadu_pd(&a[k + 6]));
+      }
+      break;
+
+      case STREAM_SCALE:
+      for (; k + 8 <= n; k += 8) {
+         _mm_storeu_pd(&b[k], _mm_mul_pd(vs, _mm_loadu_pd(&c[k])));
+         _mm_storeu_pd(&b[k + 2], _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 2])));
+         _mm_storeu_pd(&b[k + 4], _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 4])));
+         _mm_storeu_pd(&b[k + 6], _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 6])));
+      }
+      break;
+
+      case STREAM_ADD:
+      for (; k + 8 <= n; k += 8) {
+         _mm_storeu_pd(&c[k], _mm_add_pd(_mm_loadu_pd(&a[k]), _mm_loadu_pd(&b[k])));
+         _mm_storeu_pd(&c[k + 2], _mm_add_pd(_mm_loadu_pd(&a[k + 2]), _mm_loadu_pd(&b[k + 2])));
+         _mm_storeu_pd(&c[k + 4], _mm_add_pd(_mm_loadu_pd(&a[k + 4]), _mm_loadu_pd(&b[k + 4])));
+         _mm_storeu_pd(&c[k + 6], _mm_add_pd(_mm_loadu_pd(&a[k + 6]), _mm_loadu_pd(&b[k + 6])));
+      }
+      break;
+
+      case STREAM_TRIAD:
+      for (; k + 8 <= n; k += 8) {
+         _mm_storeu_pd(&a[k], _mm_add_pd(_mm_loadu_pd(&b[k]),
+                                         _mm_mul_pd(vs, _mm_loadu_pd(&c[k]))));
+         _mm_storeu_pd(&a[k + 2], _mm_add_pd(_mm_loadu_pd(&b[k + 2]),
+                                             _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 2]))));
+         _mm_storeu_pd(&a[k + 4], _mm_add_pd(_mm_loadu_pd(&b[k + 4]),
+                                             _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 4]))));
+         _mm_storeu_pd(&a[k + 6], _mm_add_pd(_mm_loadu_pd(&b[k + 6]),
+                                             _mm_mul_pd(vs, _mm_loadu_pd(&c[k + 6]))));
+      }
+      break;
+   } // End switch
+#endif
+
+   // Scalar loop for the tail, or everything without SSE2
+   for (; k < n; k++) {
+      switch (job->kernel) {
+         case STREAM_INIT:  a[k] = INIT_A; b[k] = INIT_B; c[k] = INIT_C; break;
+         case STREAM_COPY:  c[k] = a[k]; break;
+         case STREAM_SCALE: b[k] = s*c[k]; break;
+         case STREAM_ADD:   c[k] = a[k] + b[k]; break;
+         case STREAM_TRIAD: a[k] = b[k] + s*c[k]; break;
+      }
+   }
+   return(NULL);
+} // End streamWorker
+
+
+/****************************************************************************
+  Run one pass on the first numWorkers workers and wait for them
+****************************************************************************/
+static int streamPass(struct Pool_s *pool, struct StreamJob_s *jobs, int numWorkers,
+                      int kernel) {
+   int rc = 0;
+
+   for (int i = 0; i < numWorkers; i++) {
+      jobs[i].kernel = kernel;
+      rc |= poolStart(pool, i, streamWorker, &jobs[i]);
+   }
+   for (int i = 0; i < numWorkers; i++) {
+      poolJoin(pool, i, NULL);
+   }
+   return(rc);
+} // End streamPass
+
+
+/****************************************************************************
+  Measure the four kernels
+
+  int streamBench(struct Pool_s *pool, int numWorkers, double *a, double *b,
+                  double *c, long count, double gbps[STREAM_KERNELS])
+  Where: struct Pool_s *pool - the worker pool
+         int numWorkers      - workers to use, the first ones of the pool
+         double *a, *b, *c   - the arrays, count elements each
+         long count          - elements per array
+         double gbps[]       - receives the best rate of each kernel in GB/s
+  Returns: int - 0 on success, -1 if a worker could not be started or the
+                 results are wrong
+  Errors: none
+****************************************************************************/
+int streamBench(struct Pool_s *pool, int numWorkers, double *a, double *b,
+                double *c, long count, double gbps[STREAM_KERNELS]) {
+   struct StreamJob_s *jobs;
+   double best[STREAM_KERNELS];
+   double ea = INIT_A, eb = INIT_B, ec = INIT_C;
+   long bad = 0;
+
+   if (posix_memalign((void **)&jobs, CACHE_LINE_SIZE, numWorkers*sizeof(*jobs))) {
+      return(-1);
+   }
+   // Same segments as the fill, the remainder spread over the first ones
+   for (int i = 0; i < numWorkers; i++) {
+      jobs[i].a = a;
+      jobs[i].b = b;
+      jobs[i].c = c;
+      jobs[i].start = (count/numWorkers)*i +
+                      ((i < count%numWorkers) ? i : count%numWorkers);
+      jobs[i].size = count/numWorkers + (i < count%numWorkers);
+   }
+
+   if (streamPass(pool, jobs, numWorkers, STREAM_INIT)) {
+      free(jobs);
+      return(-1);
+   }
+   for (int k = 0; k < STREAM_KERNELS; k++) {
+      best[k] = HUGE_VAL;
+   }
+   for (int r = 0; r < STREAM_REPS; r++) {
+      for (int k = 0; k < STREAM_KERNELS; k++) {
+         DECLARE_WTIMER(passTimer)
+         START_NTIMER(passTimer);
+         streamPass(pool, jobs, numWorkers, k);
+         STOP_NTIMER(passTimer);
+         if (ELAPSED_NTIMER(passTimer) < best[k]) {
+            best[k] = ELAPSED_NTIMER(passTimer);
+         }
+      }
+      // Follow the values through the same sequence, as STREAM checks
+      ec = ea;
+      eb = STREAM_SCALAR*ec;
+      ec = ea + eb;
+      ea = eb + STREAM_SCALAR*ec;
+   } // End for repetitions
+   free(jobs);
+
+   for (int k = 0; k < STREAM_KERNELS; k++) {
+      gbps[k] = (best[k] > 0.0) ? 1e-9*kernelBytes[k]*(double)count/best[k] : 0.0;
+   }
+
+   // Every element of an array ends with the same value
+   for (long i = 0; i < count; i++) {
+      bad += (ABS(a[i] - ea) > EPSILON*ABS(ea)) || (ABS(b[i] - eb) > EPSILON*ABS(eb)) ||
+             (ABS(c[i] - ec) > EPSILON*ABS(ec));
+   }
+   return((bad == 0) ? 0 : -1);
+} // End streamBench
+
+
+/****************************************************************************
+  Name of a kernel
+
+  const char *streamName(int kernel)
+  Where: int kernel - one of the STREAM_xxx values
+  Returns: const char * - copy, scale, add or triad
+  Errors: none
+****************************************************************************/
+const char *streamName(int kernel) {
+   if (kernel < 0 || kernel >= STREAM_KERNELS) {
+      return("unknown");
+   }
+   return(kernelNames[kernel]);
+} // End streamName
@@ -0,0 +1,34 @@
+/******************************************************************************
+* STREAM style memory bandwidth kernels for hw13
+*
+* The four kernels of McCalpin's STREAM benchmark on double arrays:
+*   copy  - c[i] = a[i]              16 bytes per element
+*   scale - b[i] = s*c[i]            16 bytes per element
+*   add   - c[i] = a[i] + b[i]       24 bytes per element
+*   triad - a[i] = b[i] + s*c[i]     24 bytes per element
+* Each pass splits the arrays into one contiguous segment per worker, laid
+* out like the fill segments, and runs on the first numWorkers workers of
+* the pool so the same pinned threads can be measured at every count.  The
+* best time of the repetitions is reported, as STREAM does.
+******************************************************************************/
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include "pool.h"
+
+/* Kernels */
+#define STREAM_COPY         (0)
+#define STREAM_SCALE        (1)
+#define STREAM_ADD          (2)
+#define STREAM_TRIAD        (3)
+#define STREAM_KERNELS      (4)
+
+/* Timed repetitions of each kernel */
+#define STREAM_REPS         (5)
+
+/* Function prototypes */
+int streamBench(struct Pool_s *pool, int numWorkers, double *a, double *b,
+                double *c, long count, double gbps[STREAM_KERNELS]);
+const char *streamName(int kernel);
+
+#endif /* _STREAM_H_ */
@@ -0,0 +1,117 @@
+//  Calibrated synthetic work for hw13
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define EN_TIME
+#include "Timers.h"
+#include "work.h"
+
+/*--------------------------------------------------------------------------
+  Local data structures and defines
+--------------------------------------------------------------------------*/
+// Multiply-add constants, x stays bounded and never goes denormal
+#define WORK_MUL            (0.9999999)
+#define WORK_ADD            (1e-7)
+
+// Calibration runs the work the way the fill does, short chains for many
+// elements that the CPU can overlap, the best of a few runs is kept
+#define CALIBRATE_ELEMS     (1L << 14)
+#define CALIBRATE_ITERS     (64)
+#define CALIBRATE_RUNS      (3)
+
+// Keeps the calibration result alive
+static volatile double calibrateSink;
+
+
+/****************************************************************************
+  Run the work of one element
+
+  double workElem(double seed, long iters)
+  Where: double seed - starting value, the element value
+         long iters  - multiply-add iterations
+  Returns: double - end of the chain, the caller must keep it
+  Errors: none
+****************************************************************************/
+double workElem(double seed, long iters) {
+   double x = seed;
+
+   for (long k = 0; k < iters; k++) {
+      x = x*WORK_MUL + WORK_ADD;
+   }
+   return(x);
+} // End workElem
+
+
+/****************************************************************************
+  Run the work of a range of elements, each seeded by its value
+
+  double workChunk(const elem_t *src, long count, long iters)
+  Where: const elem_t *src - the elements
+         long count        - number of elements
+         long iters        - iterations per element
+  Returns: double - sum of the chain ends, the caller must keep it
+  Errors: none
+****************************************************************************/
+double workChunk(const elem_t *src, long count, long iters) {
+   double sum = 0.0;
+
+   for (long k = 0; k < count; k++) {
+      sum += workElem((double)src[k], iters);
+   }
+   return(sum);
+} // End workChunk
+
+
+/****************************************************************************
+  Measure the cost of one iteration on this host, the best of a few runs
+
+  double workCalibrate(void)
+  Returns: double - nanoseconds per iteration
+  Errors: none
+****************************************************************************/
+double workCalibrate(void) {
+   static elem_t seeds[CALIBRATE_ELEMS];
+   double best = 0.0;
+
+   for (long k = 0; k < CALIBRATE_ELEMS; k++) {
+      seeds[k] = (elem_t)k;
+   }
+   for (int r = 0; r < CALIBRATE_RUNS; r++) {
+      DECLARE_WTIMER(calTimer)
+      START_NTIMER(calTimer);
+      calibrateSink = workChunk(seeds, CALIBRATE_ELEMS, CALIBRATE_ITERS);
+      STOP_NTIMER(calTimer);
+      if (r == 0 || ELAPSED_NTIMER(calTimer) < best) {
+         best = ELAPSED_NTIMER(calTimer);
+      }
+   }
+   return(best*1e9/(CALIBRATE_ELEMS*CALIBRATE_ITERS));
+} // End workCalibrate
+
+
+/****************************************************************************
+  Convert a work spec to iterations per element
+
+  long workIters(const char *spec, double nsPerIter)
+  Where: const char *spec  - nanoseconds (25, 25ns) or FLOPs (100f, 100flops)
+         double nsPerIter  - calibrated cost of one iteration
+  Returns: long - iterations per element, -1 if the spec is not valid
+  Errors: none
+****************************************************************************/
+long workIters(const char *spec, double nsPerIter) {
+   char *end;
+   double amount = strtod(spec, &end);
+
+   if (end == spec || amount < 0.0) {
+      return(-1);
+   }
+   if (strcmp(end, "f") == 0 || strcmp(end, "flops") == 0) {
+      return((long)(amount/2.0 + 0.5));
+   }
+   if (*end != '\0' && strcmp(end, "ns") != 0) {
+      return(-1);
+   }
+   return((nsPerIter > 0.0) ? (long)(amount/nsPerIter + 0.5) : 0);
+} // End workIters
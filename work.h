@@ -0,0 +1,32 @@
+/******************************************************************************
+* Calibrated synthetic work for hw13
+*
+* The work for one element is a dependent chain of multiply-add iterations
+* on a double seeded by the element value, 2 FLOPs per iteration.  The
+* chain can not be computed ahead because of the seed and can not be
+* dropped because its result is returned and kept by the caller, so the
+* optimizer has to leave it in at any level.
+*
+* The cost of one iteration is measured at startup, so the amount of work
+* can be given in nanoseconds per element and means the same on every host,
+* or in FLOPs per element for a fixed arithmetic intensity.
+*
+* Specs: 25 or 25ns - about 25 ns per element
+*        100f        - 100 FLOPs (50 iterations) per element
+******************************************************************************/
+#ifndef _WORK_H_
+#define _WORK_H_
+
+#include "fill.h"
+
+/* Work of the scalar reference loop when none is given, it stands in for
+   the old delay loop so the status updates can be seen */
+#define WORK_DEFAULT_NS     (25.0)
+
+/* Function prototypes */
+double workCalibrate(void);
+long workIters(const char *spec, double nsPerIter);
+double workElem(double seed, long iters);
+double workChunk(const elem_t *src, long count, long iters);
+
+#endif /* _WORK_H_ */